@@ -1,58 +1,116 @@
 #include "application.h"
 
 #include "utils.h"
-#include "benchmark.h"
+#include "benchmark_suite.h"
+#include "probe.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
 #include <stdio.h>
 
+namespace
+{
+	const WorkloadSettings WORKLOAD_PRESETS[] {
+		//  Small objects churning in a steady state
+		{ "Uniform", 16, 256, WorkloadSizeDistribution::Uniform, 0.5f, 2000.0f, 2000 },
+		//  Mostly small objects with a few large buffers, living longer
+		{ "Mixed", 16, 16 * 1024, WorkloadSizeDistribution::Exponential, 0.5f, 20000.0f, 2000 },
+		//  Slowly growing set of long-lived objects, fragmenting over time
+		{ "Growing", 16, 1024, WorkloadSizeDistribution::Uniform, 0.55f, 50000.0f, 2000 },
+	};
+	const int WORKLOAD_PRESET_COUNT = sizeof( WORKLOAD_PRESETS ) / sizeof( WORKLOAD_PRESETS[0] );
+
+	//  Time the workload operations for the dashboard, even when the freelist probes are compiled out
+	Probe workload_reserve_probe( "Application::workload_reserve" );
+	Probe workload_unreserve_probe( "Application::workload_unreserve" );
+
+	Color lerp_color( const Color& a, const Color& b, float ratio )
+	{
+		return Color {
+			(unsigned char)( a.r + ( b.r - a.r ) * ratio ),
+			(unsigned char)( a.g + ( b.g - a.g ) * ratio ),
+			(unsigned char)( a.b + ( b.b - a.b ) * ratio ),
+			(unsigned char)( a.a + ( b.a - a.a ) * ratio ),
+		};
+	}
+}
+
 Application::Application( const Rectangle& frame )
-	: _frame( frame ), 
-	 _freelist( 2048 )
+	: _frame( frame )
 {
 	_font = GetFontDefault();
 
+	_create_freelist( DEMO_DATA_SIZE );
+	_workload.set_settings( WORKLOAD_PRESETS[0] );
+
 	if ( ENABLE_BENCHMARKS )
 	{
-		Benchmark benchmark {};
-
-		//  Benchmarking the new/delete operations
-		benchmark.start();
-		for ( int i = 0; i < BENCHMARK_ITERATIONS; i++ )
-		{
-			auto entity = new ExpensiveEntity();
-			entity->is_alive = false;
-			delete entity;
-		}
-		benchmark.stop();
-		printf( "Benchmark: new(): %.3f seconds for a total of %d iterations\n", benchmark.get_seconds(), BENCHMARK_ITERATIONS );
+		benchmarks::run_entity_benchmark( BENCHMARK_ITERATIONS );
+		benchmarks::run_slab_benchmark( BENCHMARK_ITERATIONS );
+		benchmarks::run_persistence_benchmark( BENCHMARK_ITERATIONS );
+		benchmarks::run_shared_benchmark( BENCHMARK_ITERATIONS );
+		benchmarks::run_transaction_benchmark( BENCHMARK_ITERATIONS );
+		benchmarks::run_deferred_free_benchmark( BENCHMARK_ITERATIONS );
+		benchmarks::run_lifetime_benchmark( BENCHMARK_ITERATIONS );
+		benchmarks::run_entity_store_benchmark( BENCHMARK_ITERATIONS );
+		benchmarks::run_cache_placement_benchmark( BENCHMARK_ITERATIONS );
+	}
 
-		//  Benchmarking the freelist allocate/free operations
-		benchmark.start();
-		for ( int i = 0; i < BENCHMARK_ITERATIONS; i++ )
-		{
-			uint32_t size = sizeof( ExpensiveEntity );
-			uint32_t offset;
-			if ( _freelist.reserve( size, offset ) )
-			{
-				auto entity = (ExpensiveEntity*)_freelist.pointer_to_memory( offset );
-				entity->is_alive = false;
-				_freelist.unreserve( offset, size );
-			}
-		}
-		benchmark.stop();
-		printf( "Benchmark: freelist: %.3f seconds for a total of %d iterations\n", benchmark.get_seconds(), BENCHMARK_ITERATIONS );
+	if ( ENABLE_STATS_DUMP )
+	{
+		_stats_dumper.reset( new StatsDumper( STATS_DUMP_PATH, StatsDumpFormat::CSV, STATS_DUMP_INTERVAL ) );
 	}
 }
 
 void Application::update( float dt )
 {
+	if ( _stats_dumper )
+	{
+		_stats_dumper->update( *_freelist, dt );
+	}
+
 	if ( IsKeyPressed( KEY_E ) )
 	{
 		show_only_user_data = !show_only_user_data;
+		_reset_view();
+	}
+	else if ( IsKeyPressed( KEY_L ) )
+	{
+		if ( _freelist->get_data_size() == DEMO_DATA_SIZE )
+		{
+			if ( _create_freelist( LARGE_DATA_SIZE ) )
+			{
+				_fill_randomly( LARGE_RESERVATION_COUNT );
+			}
+		}
+		else
+		{
+			_create_freelist( DEMO_DATA_SIZE );
+		}
+	}
+	else if ( IsKeyPressed( KEY_R ) )
+	{
+		_reset_view();
+	}
+	else if ( IsKeyPressed( KEY_W ) )
+	{
+		_is_workload_running = !_is_workload_running;
+		_reset_workload_samples();
+	}
+	else if ( IsKeyPressed( KEY_D ) )
+	{
+		_is_deferred_free = !_is_deferred_free;
+		_freelist->set_deferred_free( _is_deferred_free ? DEFERRED_FREE_CAPACITY : 0 );
+		printf( "Un-reservations are now %s\n", _is_deferred_free ? "deferred" : "immediate" );
 	}
 	else if ( IsKeyPressed( KEY_C ) )
 	{
 		clear();
 	}
+	else if ( IsKeyPressed( KEY_P ) )
+	{
+		Probe::print_all();
+	}
 	else if ( IsKeyPressed( KEY_H ) )
 	{
 		auto entity = reserve<ExpensiveEntity>();
@@ -85,34 +143,29 @@ void Application::update( float dt )
 		printf( "Reserved a new CheaperEntity!\n" );
 	}
 
-	int mem_offset = 0;
-	if ( !show_only_user_data )
+	_update_view();
+
+	if ( _is_workload_running )
 	{
-		mem_offset += _freelist.get_internal_size();
+		_update_workload( dt );
 	}
 
 	//  User click on allocations
 	if ( IsMouseButtonPressed( MOUSE_BUTTON_LEFT ) )
 	{
-		const Vector2 mouse_pos = GetMousePosition();
-
-		for ( int i = 0; i < _reservations.size(); i++ )
+		const ReservationId id = _find_reservation_at( GetMousePosition() );
+		if ( id.is_valid() )
 		{
-			const Reservation& reservation = _reservations[i];
-
-			const Rectangle region = _create_memory_region_rect(
-				mem_offset + reservation.offset,
-				reservation.size
-			);
-
-			//  Check click on reserved region to un-reserve
-			bool is_hovered = CheckCollisionPointRec( mouse_pos, region );
-			if ( !is_hovered ) continue;
-
-			unreserve( i );
-			break;
+			unreserve( id );
 		}
 	}
+
+	//  Apply the frame deferred un-reservations at once
+	const FreelistError error = _freelist->flush();
+	if ( error != FreelistError::None )
+	{
+		printf( "Freelist couldn't flush the deferred un-reservations (%s)\n", freelist_error_to_str( error ) );
+	}
 }
 
 void Application::render()
@@ -128,11 +181,8 @@ void Application::render()
 	_total_memory_rect.y = _frame.height * 0.575f - _total_memory_rect.height * 0.5f;
 	DrawRectangleRec( _total_memory_rect, LIGHTGRAY );
 
-	const int data_size = _freelist.get_data_size();
-	const int total_size = _freelist.get_total_size();
-	const int internal_size = _freelist.get_internal_size();
-
-	_total_size = (float)( show_only_user_data ? data_size : total_size );
+	const int data_size = _freelist->get_data_size();
+	const int internal_size = _freelist->get_internal_size();
 
 	//  Draw title text
 	_draw_text( 
@@ -168,57 +218,78 @@ void Application::render()
 		mem_offset += internal_size;
 	}
 
-	//  Draw freelist nodes
-	int index = 0;
-	FreelistNode* head = _freelist.head();
-	FreelistNode* node = head;
-	while( node )
-	{
-		const char* text = TextFormat(
-			"%s%s",
-			node == head ? "*" : "",
-			utils::bytes_to_str( node->size )
-		);
-
-		const Rectangle region = _create_memory_region_rect(
-			mem_offset + node->offset,
-			node->size
-		);
-		_draw_memory_region( region, text, font_size, spacing, GREEN );
-
-		index++;
-		node = node->next;
-	}
-
 	//  Draw user memory region
 	{
 		const Rectangle region = _create_memory_region_rect( mem_offset, data_size );
 		_draw_memory_region_label( region, "User Size" );
 	}
 
-	//  Draw reservations
-	for ( int i = 0; i < _reservations.size(); i++ )
+	if ( _is_view_exact() )
 	{
-		const Reservation& reservation = _reservations[i];
+		//  Draw freelist nodes
+		FreelistNode* head = _freelist->head();
+		FreelistNode* node = head;
+		while( node )
+		{
+			//  Nodes are sorted by offset, the remaining ones are out of view
+			if ( mem_offset + node->offset >= _view_offset + _view_size ) break;
 
-		const Rectangle region = _create_memory_region_rect(
-			mem_offset + reservation.offset,
-			reservation.size
-		);
+			const Rectangle region = _create_memory_region_rect(
+				mem_offset + node->offset,
+				node->size
+			);
+			if ( region.width > 0.0f )
+			{
+				const char* text = TextFormat(
+					"%s%s",
+					node == head ? "*" : "",
+					utils::bytes_to_str( node->size )
+				);
+				_draw_memory_region( region, text, font_size, spacing, GREEN );
+			}
 
-		bool is_hovered = CheckCollisionPointRec( GetMousePosition(), region );
-		_draw_memory_region(
-			region,
-			utils::bytes_to_str( reservation.size ),
-			font_size,
-			spacing,
-			is_hovered ? PURPLE : VIOLET
+			node = _freelist->next( node );
+		}
+
+		//  Draw visible reservations
+		const ReservationId hovered_id = _find_reservation_at( GetMousePosition() );
+		const double view_start = std::max( _view_offset - mem_offset, 0.0 );
+		const double view_end = std::max( _view_offset + _view_size - mem_offset, 0.0 );
+		_reservations.visit_range(
+			(uint32_t)view_start,
+			(uint32_t)( view_end - view_start ) + 1,
+			[&]( ReservationId id, const Reservation& reservation )
+			{
+				const Rectangle region = _create_memory_region_rect(
+					mem_offset + reservation.offset,
+					reservation.size
+				);
+
+				const bool is_hovered = id.index == hovered_id.index;
+				_draw_memory_region(
+					region,
+					utils::bytes_to_str( reservation.size ),
+					font_size,
+					spacing,
+					is_hovered ? PURPLE : VIOLET
+				);
+			}
 		);
 	}
+	else
+	{
+		_draw_heat_strip( mem_offset );
+	}
 
-	//  Draw nodes count
+	//  Draw nodes count and fragmentation
+	const FreelistStats stats = _freelist->get_stats();
 	_draw_text( 
-		TextFormat( "%i NODES", index ), 
+		TextFormat(
+			"%i NODES - LARGEST %s - %.1f%% FRAGMENTED",
+			stats.free_block_count,
+			utils::bytes_to_str( stats.largest_free_size ),
+			stats.get_fragmentation() * 100.0f
+		), 
 		Vector2 {
 			_total_memory_rect.x,
 			_total_memory_rect.y + _total_memory_rect.height,
@@ -229,13 +300,40 @@ void Application::render()
 		BLACK
 	);
 
+	//  Draw zoom and level of detail
+	_draw_text( 
+		_is_view_exact()
+			? TextFormat( "ZOOM x%.1f - EXACT", _total_size / _view_size )
+			: TextFormat( "ZOOM x%.1f - %s PER COLUMN", _total_size / _view_size, utils::bytes_to_str( _heat_strip.get_column_size() ) ),
+		Vector2 {
+			_total_memory_rect.x + _total_memory_rect.width,
+			_total_memory_rect.y + _total_memory_rect.height,
+		},
+		Vector2 { 1.0f, 0.0f },
+		font_size,
+		spacing,
+		BLACK
+	);
+
+	if ( _is_workload_running )
+	{
+		_draw_dashboard();
+	}
+
 	//  Draw instructions
-	const int instructions_count = 5;
+	const int instructions_count = 12;
 	const char* instructions[instructions_count] {
 		"J: Reserve a CheaperEntity (64.00B)",
 		"H: Reserve an ExpensiveEntity (160.00B)",
 		"E: Toggle Internal Size visualisation",
 		"C: Clear the freelist",
+		"D: Toggle deferred un-reservations",
+		"P: Print the freelist latency probes",
+		"L: Toggle a large arena filled with random reservations",
+		"R: Reset the zoom and pan",
+		"W: Toggle the synthetic workload",
+		"1-3: Workload preset, UP/DOWN: operations, LEFT/RIGHT: reserve ratio",
+		"WHEEL/RMB: Zoom and pan over the memory",
 		"LMB: Click on reserved regions to free them",
 	};
 	Vector2 pos { 24.0f, _frame.height - 24.0f };
@@ -253,31 +351,71 @@ void Application::render()
 	}
 }
 
-int Application::reserve( uint32_t size )
+ReservationId Application::reserve( uint32_t size )
 {
-	uint32_t offset = 0;
-	if ( !_freelist.reserve( size, offset ) ) return -1;
-
-	Reservation reservation {};
-	reservation.data = _freelist.pointer_to_memory( offset );
-	reservation.offset = offset;
-	reservation.size = size;
-	_reservations.push_back( reservation );
+	FreelistError error = FreelistError::None;
+	const ReservationId id = _reserve( size, error );
+	if ( error != FreelistError::None )
+	{
+		printf(
+			"Freelist couldn't reserve %s (%s), free space: %s\n",
+			utils::bytes_to_str( size ),
+			freelist_error_to_str( error ),
+			utils::bytes_to_str( _freelist->get_free_size() )
+		);
+	}
 
-	return (int)_reservations.size() - 1;
+	return id;
 }
 
-void Application::unreserve( int id )
+void Application::unreserve( ReservationId id )
 {
-	const Reservation& reservation = _reservations.at( id );
-	_freelist.unreserve( reservation.offset, reservation.size );
-	_reservations.erase( _reservations.begin() + id );
+	const Reservation* reservation = _reservations.get( id );
+	if ( reservation == nullptr ) return;
+
+	const uint32_t size = reservation->size;
+	const FreelistError error = _unreserve( id );
+	if ( error != FreelistError::None )
+	{
+		printf( "Freelist couldn't un-reserve %s (%s)\n", utils::bytes_to_str( size ), freelist_error_to_str( error ) );
+	}
 }
 
 void Application::clear()
 {
-	_freelist.clear();
+	_freelist->clear();
 	_reservations.clear();
+	_workload.clear();
+	_heat_strip.invalidate();
+}
+
+ReservationId Application::_reserve( uint32_t size, FreelistError& error )
+{
+	uint32_t offset = 0;
+	error = _freelist->reserve( size, offset );
+	if ( error != FreelistError::None ) return ReservationId {};
+
+	_heat_strip.on_reserved( offset, size );
+
+	Reservation reservation {};
+	reservation.data = _freelist->pointer_to_memory( offset );
+	reservation.offset = offset;
+	reservation.size = size;
+	return _reservations.add( reservation );
+}
+
+FreelistError Application::_unreserve( ReservationId id )
+{
+	const Reservation* found_reservation = _reservations.get( id );
+	if ( found_reservation == nullptr ) return FreelistError::None;
+
+	const Reservation& reservation = *found_reservation;
+	const FreelistError error = _freelist->unreserve( reservation.offset, reservation.size );
+	if ( error != FreelistError::None ) return error;
+
+	_heat_strip.on_unreserved( reservation.offset, reservation.size );
+	_reservations.remove( id );
+	return FreelistError::None;
 }
 
 void Application::_draw_text( 
@@ -310,11 +448,22 @@ void Application::_draw_text(
 
 Rectangle Application::_create_memory_region_rect( uint32_t offset, uint32_t size ) const
 {
+	const float view_left = _total_memory_rect.x;
+	const float view_right = _total_memory_rect.x + _total_memory_rect.width;
+
+	//  Clip to the visible part of the memory
+	float left = (float)( view_left + ( offset - _view_offset ) / _view_size * _total_memory_rect.width );
+	float right = (float)( left + size / _view_size * _total_memory_rect.width );
+	left = std::max( left, view_left );
+	right = std::min( right, view_right );
+
+	//  Shrink the padding of narrow regions so they stay visible
+	const float padding = std::min( MEMORY_RECT_PADDING, ( right - left ) * 0.25f );
+
 	Rectangle memory_rect( _total_memory_rect );
-	memory_rect.x += MEMORY_RECT_PADDING + offset / _total_size * _total_memory_rect.width;
+	memory_rect.x = left + padding;
 	memory_rect.y += MEMORY_RECT_PADDING;
-	memory_rect.width = size / _total_size * _total_memory_rect.width;
-	memory_rect.width -= MEMORY_RECT_PADDING * 2.0f;
+	memory_rect.width = right - left - padding * 2.0f;
 	memory_rect.height -= MEMORY_RECT_PADDING * 2.0f;
 	return memory_rect;
 }
@@ -327,6 +476,9 @@ void Application::_draw_memory_region(
 	const Color& color
 ) const
 {
+	//  Out of view
+	if ( region.width <= 0.0f ) return;
+
 	//  Draw memory region
 	DrawRectangleRec( region, color );
 
@@ -388,3 +540,376 @@ void Application::_draw_memory_region_label( const Rectangle& region, const char
 		GRAY
 	);
 }
+
+bool Application::_create_freelist( uint32_t data_size )
+{
+	_freelist.reset( new Freelist( data_size ) );
+	_freelist->set_deferred_free( _is_deferred_free ? DEFERRED_FREE_CAPACITY : 0 );
+	_reservations.clear();
+	_workload.clear();
+	_heat_strip.invalidate();
+	_reset_view();
+
+	if ( _freelist->is_valid() )
+	{
+		printf(
+			"Freelist was initialized for a data size of %s, using at maximum %d nodes and for a total size of %s\n",
+			utils::bytes_to_str( _freelist->get_data_size() ),
+			_freelist->get_node_count(),
+			utils::bytes_to_str( _freelist->get_total_size() )
+		);
+	}
+	else
+	{
+		printf(
+			"Freelist failed to allocate memory for a data size of %s, using at maximum %d nodes and for a total size of %s\n",
+			utils::bytes_to_str( _freelist->get_data_size() ),
+			_freelist->get_node_count(),
+			utils::bytes_to_str( _freelist->get_total_size() )
+		);
+
+		//  Keep something to draw and reserve into
+		if ( data_size != DEMO_DATA_SIZE )
+		{
+			_create_freelist( DEMO_DATA_SIZE );
+		}
+		return false;
+	}
+
+	return true;
+}
+
+void Application::_fill_randomly( int count )
+{
+	std::mt19937 random( 1337 );
+	std::uniform_int_distribution<uint32_t> size_distribution( LARGE_RESERVATION_MIN_SIZE, LARGE_RESERVATION_MAX_SIZE );
+	std::uniform_int_distribution<int> percent( 0, 99 );
+
+	//  Some reservations are immediately followed by a gap, freed afterward to fragment the memory
+	std::vector<Reservation> gaps {};
+	for ( int i = 0; i < count; i++ )
+	{
+		Reservation reservation {};
+		reservation.size = size_distribution( random );
+		if ( _freelist->reserve( reservation.size, reservation.offset ) != FreelistError::None ) break;
+
+		reservation.data = _freelist->pointer_to_memory( reservation.offset );
+		_reservations.add( reservation );
+
+		if ( percent( random ) < 25 )
+		{
+			Reservation gap {};
+			gap.size = size_distribution( random );
+			if ( _freelist->reserve( gap.size, gap.offset ) != FreelistError::None ) break;
+
+			gaps.push_back( gap );
+		}
+	}
+
+	for ( const Reservation& gap : gaps )
+	{
+		_freelist->unreserve( gap.offset, gap.size );
+	}
+
+	_heat_strip.invalidate();
+
+	const FreelistStats stats = _freelist->get_stats();
+	printf(
+		"Filled the freelist with %d reservations and %d free blocks\n",
+		_reservations.get_count(),
+		stats.free_block_count
+	);
+}
+
+ReservationId Application::_find_reservation_at( const Vector2& pos ) const
+{
+	if ( !CheckCollisionPointRec( pos, _total_memory_rect ) ) return ReservationId {};
+
+	int mem_offset = 0;
+	if ( !show_only_user_data )
+	{
+		mem_offset += _freelist->get_internal_size();
+	}
+
+	//  Pixel to address in the view
+	const double address = _view_offset + ( pos.x - _total_memory_rect.x ) / _total_memory_rect.width * _view_size;
+	if ( address < mem_offset ) return ReservationId {};
+
+	return _reservations.find( (uint32_t)( address - mem_offset ) );
+}
+
+void Application::_reset_view()
+{
+	_view_offset = 0.0;
+	_view_size = 0.0;
+}
+
+void Application::_update_view()
+{
+	_total_size = (float)( show_only_user_data ? _freelist->get_data_size() : _freelist->get_total_size() );
+	if ( _view_size <= 0.0 )
+	{
+		_view_size = _total_size;
+	}
+
+	//  Not rendered yet
+	if ( _total_memory_rect.width <= 0.0f ) return;
+
+	const Vector2 mouse_pos = GetMousePosition();
+
+	//  Zoom around the mouse, keeping the address under it in place
+	const float wheel = GetMouseWheelMove();
+	if ( wheel != 0.0f && CheckCollisionPointRec( mouse_pos, _total_memory_rect ) )
+	{
+		const double ratio = ( mouse_pos.x - _total_memory_rect.x ) / _total_memory_rect.width;
+		const double address = _view_offset + ratio * _view_size;
+
+		_view_size *= pow( MEMORY_ZOOM_FACTOR, -wheel );
+		_view_size = std::max( _view_size, MEMORY_MIN_VIEW_SIZE );
+		_view_offset = address - ratio * _view_size;
+	}
+
+	//  Pan by dragging
+	if ( IsMouseButtonDown( MOUSE_BUTTON_RIGHT ) )
+	{
+		_view_offset -= GetMouseDelta().x / _total_memory_rect.width * _view_size;
+	}
+
+	_view_size = std::min( _view_size, (double)_total_size );
+	_view_offset = std::min( std::max( _view_offset, 0.0 ), _total_size - _view_size );
+}
+
+bool Application::_is_view_exact() const
+{
+	return _view_size <= MEMORY_LOD_MAX_VIEW_SIZE;
+}
+
+void Application::_draw_heat_strip( int mem_offset )
+{
+	const double data_size = _freelist->get_data_size();
+
+	//  Visible part of the user data
+	const double view_start = std::min( std::max( _view_offset - mem_offset, 0.0 ), data_size );
+	const double view_end = std::min( std::max( _view_offset + _view_size - mem_offset, 0.0 ), data_size );
+	if ( view_end <= view_start ) return;
+
+	const float x = (float)( _total_memory_rect.x + ( mem_offset + view_start - _view_offset ) / _view_size * _total_memory_rect.width );
+	const float width = (float)( ( view_end - view_start ) / _view_size * _total_memory_rect.width );
+
+	_heat_strip.set_range( (uint32_t)view_start, (uint32_t)( view_end - view_start ), (int)width );
+	_heat_strip.update( *_freelist );
+
+	//  Merge neighbour columns of the same shade into a single rectangle
+	const float column_width = (float)( _heat_strip.get_column_size() / ( view_end - view_start ) * width );
+	const int column_count = _heat_strip.get_column_count();
+	int run_start = 0;
+	for ( int i = 1; i <= column_count; i++ )
+	{
+		const int shade = (int)( _heat_strip.get_used_ratio( run_start ) * MEMORY_HEAT_STRIP_SHADES );
+		if ( i < column_count && (int)( _heat_strip.get_used_ratio( i ) * MEMORY_HEAT_STRIP_SHADES ) == shade ) continue;
+
+		const float run_x = x + run_start * column_width;
+		const Rectangle region {
+			run_x,
+			_total_memory_rect.y + MEMORY_RECT_PADDING,
+			std::min( x + i * column_width, x + width ) - run_x,
+			_total_memory_rect.height - MEMORY_RECT_PADDING * 2.0f,
+		};
+		DrawRectangleRec( region, lerp_color( GREEN, VIOLET, (float)shade / MEMORY_HEAT_STRIP_SHADES ) );
+
+		run_start = i;
+	}
+}
+
+void Application::_update_workload( float dt )
+{
+	WorkloadSettings& settings = _workload.get_settings();
+
+	//  Tweak settings
+	for ( int i = 0; i < WORKLOAD_PRESET_COUNT; i++ )
+	{
+		if ( IsKeyPressed( KEY_ONE + i ) )
+		{
+			_workload.set_settings( WORKLOAD_PRESETS[i] );
+		}
+	}
+	if ( IsKeyPressed( KEY_UP ) )
+	{
+		settings.operations_per_frame = std::min( settings.operations_per_frame * 2, WORKLOAD_MAX_OPERATIONS_PER_FRAME );
+	}
+	else if ( IsKeyPressed( KEY_DOWN ) )
+	{
+		settings.operations_per_frame = std::max( settings.operations_per_frame / 2, 1 );
+	}
+	else if ( IsKeyPressed( KEY_RIGHT ) )
+	{
+		settings.reserve_ratio = std::min( settings.reserve_ratio + 0.05f, 1.0f );
+	}
+	else if ( IsKeyPressed( KEY_LEFT ) )
+	{
+		settings.reserve_ratio = std::max( settings.reserve_ratio - 0.05f, 0.0f );
+	}
+
+	//  Run operations
+	for ( int i = 0; i < settings.operations_per_frame; i++ )
+	{
+		const WorkloadOperation operation = _workload.next();
+		if ( operation.is_reserve )
+		{
+			FreelistError error = FreelistError::None;
+			ReservationId id {};
+			{
+				ScopedProbe probe( workload_reserve_probe );
+				id = _reserve( operation.size, error );
+			}
+
+			if ( id.is_valid() )
+			{
+				_workload.on_reserved( id );
+			}
+			else
+			{
+				_workload_failure_count++;
+			}
+		}
+		else
+		{
+			ScopedProbe probe( workload_unreserve_probe );
+			_unreserve( operation.id );
+		}
+	}
+	_workload_operation_count += settings.operations_per_frame;
+
+	_workload_sample_time += dt;
+	if ( _workload_sample_time >= WORKLOAD_SAMPLE_INTERVAL )
+	{
+		_sample_workload();
+	}
+}
+
+void Application::_sample_workload()
+{
+	_operations_history.push( _workload_operation_count / _workload_sample_time );
+
+	//  Latencies since the last sample
+	_reserve_p50_history.push( (float)workload_reserve_probe.get_percentile( 50.0f ) );
+	_reserve_p99_history.push( (float)workload_reserve_probe.get_percentile( 99.0f ) );
+	_unreserve_p99_history.push( (float)workload_unreserve_probe.get_percentile( 99.0f ) );
+	workload_reserve_probe.reset();
+	workload_unreserve_probe.reset();
+
+	const FreelistStats stats = _freelist->get_stats();
+	_free_block_count_history.push( (float)stats.free_block_count );
+	_largest_free_size_history.push( (float)stats.largest_free_size );
+
+	_workload_sample_time = 0.0f;
+	_workload_operation_count = 0;
+}
+
+void Application::_reset_workload_samples()
+{
+	_operations_history.clear();
+	_reserve_p50_history.clear();
+	_reserve_p99_history.clear();
+	_unreserve_p99_history.clear();
+	_free_block_count_history.clear();
+	_largest_free_size_history.clear();
+
+	_workload_sample_time = 0.0f;
+	_workload_operation_count = 0;
+	_workload_failure_count = 0;
+}
+
+void Application::_draw_dashboard() const
+{
+	const float font_size = 18.0f;
+	const float spacing = 1.0f;
+	const float gap = 16.0f;
+	const int graph_count = 4;
+
+	Rectangle rect {};
+	rect.x = _total_memory_rect.x;
+	rect.y = 24.0f + font_size;
+	rect.width = ( _total_memory_rect.width - gap * ( graph_count - 1 ) ) / graph_count;
+	rect.height = _frame.height * 0.15f;
+
+	//  Operations per second
+	_draw_graph( _operations_history, rect, DARKGRAY, _operations_history.get_max() );
+	_draw_text(
+		TextFormat( "%.2f MOPS/S", _operations_history.get_last() / 1000000.0f ),
+		Vector2 { rect.x, rect.y }, Vector2 { 0.0f, 1.0f }, font_size, spacing, DARKGRAY
+	);
+	rect.x += rect.width + gap;
+
+	//  Workload latency percentiles, sharing the same scale
+	const float max_latency = std::max( _reserve_p99_history.get_max(), _unreserve_p99_history.get_max() );
+	_draw_graph( _reserve_p99_history, rect, RED, max_latency );
+	_draw_graph( _reserve_p50_history, rect, BLUE, max_latency );
+	_draw_graph( _unreserve_p99_history, rect, ORANGE, max_latency );
+	_draw_text(
+		TextFormat( "RESERVE P50 %.0fNS P99 %.0fNS", _reserve_p50_history.get_last(), _reserve_p99_history.get_last() ),
+		Vector2 { rect.x, rect.y }, Vector2 { 0.0f, 1.0f }, font_size, spacing, DARKGRAY
+	);
+	_draw_text(
+		TextFormat( "UNRESERVE P99 %.0fNS", _unreserve_p99_history.get_last() ),
+		Vector2 { rect.x, rect.y + rect.height }, Vector2 { 0.0f, 0.0f }, font_size, spacing, ORANGE
+	);
+	rect.x += rect.width + gap;
+
+	//  Free blocks
+	_draw_graph( _free_block_count_history, rect, GREEN, _free_block_count_history.get_max() );
+	_draw_text(
+		TextFormat( "%.0f FREE BLOCKS", _free_block_count_history.get_last() ),
+		Vector2 { rect.x, rect.y }, Vector2 { 0.0f, 1.0f }, font_size, spacing, DARKGRAY
+	);
+	rect.x += rect.width + gap;
+
+	//  Largest free block
+	_draw_graph( _largest_free_size_history, rect, VIOLET, _largest_free_size_history.get_max() );
+	_draw_text(
+		TextFormat( "LARGEST FREE %s", utils::bytes_to_str( (int)_largest_free_size_history.get_last() ) ),
+		Vector2 { rect.x, rect.y }, Vector2 { 0.0f, 1.0f }, font_size, spacing, DARKGRAY
+	);
+
+	//  Settings
+	const WorkloadSettings& settings = _workload.get_settings();
+	_draw_text(
+		TextFormat(
+			"WORKLOAD %s - %d OPS/FRAME - %.0f%% RESERVE - LIFETIME %.0f OPS - %d LIVE - %d FAILED",
+			settings.name,
+			settings.operations_per_frame,
+			settings.reserve_ratio * 100.0f,
+			settings.mean_lifetime,
+			_workload.get_live_count(),
+			_workload_failure_count
+		),
+		Vector2 { _total_memory_rect.x, rect.y + rect.height + 4.0f },
+		Vector2 { 0.0f, 0.0f },
+		font_size,
+		spacing,
+		DARKGRAY
+	);
+}
+
+void Application::_draw_graph( const SampleHistory& history, const Rectangle& rect, const Color& color, float max ) const
+{
+	DrawRectangleLinesEx( rect, 1.0f, LIGHTGRAY );
+	if ( history.get_count() < 2 || max <= 0.0f ) return;
+
+	//  Latest sample on the right
+	const float step = rect.width / ( history.get_capacity() - 1 );
+	const float start_x = rect.x + rect.width - step * ( history.get_count() - 1 );
+	Vector2 previous {};
+	for ( int i = 0; i < history.get_count(); i++ )
+	{
+		const Vector2 point {
+			start_x + step * i,
+			rect.y + rect.height - history.get( i ) / max * rect.height,
+		};
+		if ( i > 0 )
+		{
+			DrawLineV( previous, point, color );
+		}
+		previous = point;
+	}
+}
@@ -1,10 +1,16 @@
 #pragma once
 #include <raylib.h>
 
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "freelist.h"
+#include "heat_strip.h"
+#include "reservation_registry.h"
+#include "sample_history.h"
+#include "stats_dumper.h"
+#include "workload.h"
 
 struct ExpensiveEntity
 {
@@ -31,13 +37,6 @@ struct CheaperEntity
 	bool is_alive = true;
 };
 
-struct Reservation
-{
-	uint32_t size = 0;
-	uint32_t offset = 0;
-	void* data = nullptr;
-};
-
 class Application
 {
 public:
@@ -49,13 +48,13 @@ public:
 	template <typename T>
 	T* reserve()
 	{
-		int id = reserve( sizeof( T ) );
-		if ( id == -1 ) return nullptr;
+		const ReservationId id = reserve( sizeof( T ) );
+		if ( !id.is_valid() ) return nullptr;
 
-		return (T*)_reservations[id].data;
+		return (T*)_reservations.get( id )->data;
 	}
-	int reserve( uint32_t size );
-	void unreserve( int id );
+	ReservationId reserve( uint32_t size );
+	void unreserve( ReservationId id );
 	void clear();
 
 public:
@@ -82,12 +81,87 @@ private:
 	) const;
 	void _draw_memory_region_label( const Rectangle& region, const char* text ) const;
 
+	/*
+	 * Reserves and un-reserves without printing failures.
+	 */
+	ReservationId _reserve( uint32_t size, FreelistError& error );
+	FreelistError _unreserve( ReservationId id );
+
+	/*
+	 * Replaces the freelist by a new one of the given data size, forgetting all reservations.
+	 * Returns whenever it was allocated, the demo freelist replaces it otherwise.
+	 */
+	bool _create_freelist( uint32_t data_size );
+	/*
+	 * Reserves up to 'count' randomly sized blocks, separated by some free gaps.
+	 */
+	void _fill_randomly( int count );
+	/*
+	 * Returns the id of the reservation under the given screen position or an invalid id if none.
+	 */
+	ReservationId _find_reservation_at( const Vector2& pos ) const;
+
+	void _reset_view();
+	/*
+	 * Zooms with the mouse wheel and pans by dragging the right mouse button.
+	 */
+	void _update_view();
+	/*
+	 * Returns whenever the view is small enough to draw every block, instead of the heat strip.
+	 */
+	bool _is_view_exact() const;
+	/*
+	 * Draws the visible user data as columns shaded from free to reserved.
+	 */
+	void _draw_heat_strip( int mem_offset );
+
+	/*
+	 * Applies the workload settings keys and runs this frame operations.
+	 */
+	void _update_workload( float dt );
+	/*
+	 * Pushes the throughput, latencies and fragmentation since the last sample to the graphs.
+	 */
+	void _sample_workload();
+	void _reset_workload_samples();
+	void _draw_dashboard() const;
+	/*
+	 * Draws the history as a line, scaled so that 'max' reaches the top of the rectangle.
+	 */
+	void _draw_graph( const SampleHistory& history, const Rectangle& rect, const Color& color, float max ) const;
+
 private:
 	const bool  ENABLE_BENCHMARKS = false;
 	const int   BENCHMARK_ITERATIONS = 1000000;
 
+	const bool  ENABLE_STATS_DUMP = false;
+	const char* STATS_DUMP_PATH = "freelist_stats.csv";
+	const float STATS_DUMP_INTERVAL = 1.0f;
+
+	const uint32_t DEMO_DATA_SIZE = 2048;
+	const uint32_t LARGE_DATA_SIZE = 128 * 1024 * 1024;
+	const int   LARGE_RESERVATION_COUNT = 1000000;
+	const uint32_t LARGE_RESERVATION_MIN_SIZE = 16;
+	const uint32_t LARGE_RESERVATION_MAX_SIZE = 128;
+
+	/*
+	 * Maximum amount of queued un-reservations when they are deferred, flushed every frame otherwise
+	 */
+	const uint32_t DEFERRED_FREE_CAPACITY = 4096;
+
+	const float WORKLOAD_SAMPLE_INTERVAL = 0.25f;
+	const int   WORKLOAD_MAX_OPERATIONS_PER_FRAME = 1 << 20;
+
 	const float MEMORY_RECT_PADDING = 4.0f;
 
+	/*
+	 * Above this amount of visible bytes, the user data is drawn as a heat strip
+	 */
+	const double MEMORY_LOD_MAX_VIEW_SIZE = 16.0 * 1024.0;
+	const double MEMORY_MIN_VIEW_SIZE = 64.0;
+	const double MEMORY_ZOOM_FACTOR = 1.25;
+	const int   MEMORY_HEAT_STRIP_SHADES = 16;
+
 	const float MEMORY_REGION_LABEL_FONT_SIZE = 20.0f;
 	const float MEMORY_REGION_LABEL_SPACING = 1.0f;
 
@@ -95,10 +169,32 @@ private:
 	Font _font {};
 	Rectangle _frame {};
 
-	std::vector<Reservation> _reservations {};
+	ReservationRegistry _reservations {};
 
 	Rectangle _total_memory_rect {};
 	float _total_size = 0.0f;
 
-	Freelist _freelist;
+	/*
+	 * Visible range of the memory, in bytes
+	 */
+	double _view_offset = 0.0;
+	double _view_size = 0.0;
+	HeatStrip _heat_strip {};
+
+	Workload _workload {};
+	bool _is_workload_running = false;
+	bool _is_deferred_free = false;
+	float _workload_sample_time = 0.0f;
+	int _workload_operation_count = 0;
+	int _workload_failure_count = 0;
+
+	SampleHistory _operations_history {};
+	SampleHistory _reserve_p50_history {};
+	SampleHistory _reserve_p99_history {};
+	SampleHistory _unreserve_p99_history {};
+	SampleHistory _free_block_count_history {};
+	SampleHistory _largest_free_size_history {};
+
+	std::unique_ptr<Freelist> _freelist {};
+	std::unique_ptr<StatsDumper> _stats_dumper {};
 };
\ No newline at end of file
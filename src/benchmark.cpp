@@ -4,17 +4,14 @@ using namespace std::chrono;
 
 void Benchmark::start()
 {
-	start_point = high_resolution_clock::now();
+	start_point = steady_clock::now();
 }
 
 void Benchmark::stop()
 {
-	end_point = high_resolution_clock::now();
+	end_point = steady_clock::now();
 
-	auto start = time_point_cast<microseconds>( start_point ).time_since_epoch().count();
-	auto end = time_point_cast<microseconds>( end_point ).time_since_epoch().count();
-
-	time = static_cast<int>( end - start );
+	time = duration_cast<nanoseconds>( end_point - start_point ).count();
 }
 
 void Benchmark::reset()
@@ -22,17 +19,22 @@ void Benchmark::reset()
 	time = 0;
 }
 
-int Benchmark::get_micro_seconds() const
+int64_t Benchmark::get_nano_seconds() const
 {
 	return time;
 }
 
+int Benchmark::get_micro_seconds() const
+{
+	return static_cast<int>( time / 1000 );
+}
+
 int Benchmark::get_milliseconds() const
 {
-	return time / 1000;
+	return static_cast<int>( time / 1000000 );
 }
 
 float Benchmark::get_seconds() const
 {
-	return time / 1000000.0f;
+	return time / 1000000000.0f;
 }
\ No newline at end of file
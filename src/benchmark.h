@@ -1,6 +1,7 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 
 class Benchmark
 {
@@ -9,11 +10,12 @@ public:
 	void stop();
 	void reset();
 
+	int64_t get_nano_seconds() const;
 	int get_micro_seconds() const;
 	int get_milliseconds() const;
 	float get_seconds() const;
 
 private:
-	std::chrono::time_point<std::chrono::high_resolution_clock> start_point {}, end_point {};
-	int time = 0;
+	std::chrono::time_point<std::chrono::steady_clock> start_point {}, end_point {};
+	int64_t time = 0;
 };
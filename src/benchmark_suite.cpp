@@ -0,0 +1,1142 @@
+#include "benchmark_suite.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <random>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+#include "application.h"
+#include "benchmark.h"
+#include "entity_store.h"
+#include "freelist.h"
+#include "probe.h"
+#include "reservation_registry.h"
+#include "slab_allocator.h"
+#include "utils.h"
+
+#ifndef _WIN32
+#include <sched.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	struct ChurnResult
+	{
+		float seconds = 0.0f;
+		int failures = 0;
+	};
+
+	/*
+	 * Randomly reserves and un-reserves blocks, keeping at most 'max_live' of them alive.
+	 * The same seed is used for every allocator so that they all replay the same sequence.
+	 */
+	template <typename Allocator>
+	ChurnResult run_churn( Allocator& allocator, int iterations, int max_live )
+	{
+		struct Block
+		{
+			uint32_t offset;
+			uint32_t size;
+		};
+
+		std::mt19937 random( 1337 );
+		std::uniform_int_distribution<int> percent( 0, 99 );
+		std::uniform_int_distribution<uint32_t> large_size( 512, 2048 );
+
+		std::vector<Block> live {};
+		live.reserve( max_live );
+
+		ChurnResult result {};
+
+		Benchmark benchmark {};
+		benchmark.start();
+		for ( int i = 0; i < iterations; i++ )
+		{
+			const bool should_reserve = live.empty()
+				|| ( (int)live.size() < max_live && percent( random ) < 55 );
+			if ( should_reserve )
+			{
+				//  Mostly small entities with a few larger buffers
+				const int roll = percent( random );
+				uint32_t size = large_size( random );
+				if ( roll < 50 )
+				{
+					size = sizeof( CheaperEntity );
+				}
+				else if ( roll < 90 )
+				{
+					size = sizeof( ExpensiveEntity );
+				}
+
+				Block block { 0, size };
+				if ( allocator.reserve( block.size, block.offset ) == FreelistError::None )
+				{
+					live.push_back( block );
+				}
+				else
+				{
+					result.failures++;
+				}
+			}
+			else
+			{
+				std::uniform_int_distribution<size_t> pick( 0, live.size() - 1 );
+				const size_t index = pick( random );
+
+				allocator.unreserve( live[index].offset, live[index].size );
+				live[index] = live.back();
+				live.pop_back();
+			}
+		}
+		benchmark.stop();
+
+		result.seconds = benchmark.get_seconds();
+		return result;
+	}
+
+	void print_fragmentation( const char* name, const Freelist& freelist )
+	{
+		const FreelistStats stats = freelist.get_stats();
+
+		printf(
+			"Benchmark: %s: %d free blocks, free space %s, largest free block %s, fragmentation %.1f%%\n",
+			name,
+			stats.free_block_count,
+			utils::bytes_to_str( stats.free_size ),
+			utils::bytes_to_str( stats.largest_free_size ),
+			stats.get_fragmentation() * 100.0f
+		);
+	}
+
+	/*
+	 * Out-of-memory handler doubling the freelist, or growing it enough to fit the reservation.
+	 */
+	bool grow_on_out_of_memory( Freelist& freelist, FreelistError error, uint32_t size, void* user_data )
+	{
+		(void)error;
+		(void)user_data;
+		return freelist.grow( std::max( freelist.get_data_size(), size ) );
+	}
+
+	/*
+	 * Reserves blocks of random sizes then un-reserves every other one, so that the freelist
+	 * starts with a realistic amount of free blocks.
+	 */
+	void fragment( Freelist& freelist, int block_count )
+	{
+		std::mt19937 random( 42 );
+		std::uniform_int_distribution<uint32_t> size_distribution( 16, 512 );
+
+		std::vector<uint32_t> offsets {};
+		std::vector<uint32_t> sizes {};
+		for ( int i = 0; i < block_count; i++ )
+		{
+			uint32_t offset = 0;
+			const uint32_t size = size_distribution( random );
+			if ( freelist.reserve( size, offset ) != FreelistError::None ) break;
+
+			offsets.push_back( offset );
+			sizes.push_back( size );
+		}
+
+		for ( size_t i = 0; i < offsets.size(); i += 2 )
+		{
+			freelist.unreserve( offsets[i], sizes[i] );
+		}
+	}
+
+	/*
+	 * Sorts the latencies, in nanoseconds, and prints their median, 99th percentile and maximum.
+	 */
+	void print_latencies( const char* name, std::vector<uint64_t>& latencies )
+	{
+		if ( latencies.empty() ) return;
+
+		std::sort( latencies.begin(), latencies.end() );
+		printf(
+			"Benchmark: %s: p50 %llu ns, p99 %llu ns, max %llu ns\n",
+			name,
+			(unsigned long long)latencies[latencies.size() / 2],
+			(unsigned long long)latencies[latencies.size() * 99 / 100],
+			(unsigned long long)latencies.back()
+		);
+	}
+
+	struct TraceOperation
+	{
+		bool is_reserve = true;
+		/*
+		 * Reservation the operation applies to, in the order of the reservations
+		 */
+		int index = 0;
+		uint32_t size = 0;
+		FreelistLifetime lifetime = FreelistLifetime::Normal;
+	};
+
+	/*
+	 * Generates a trace mixing many short-lived buffers with a growing set of long-lived objects,
+	 * each of them un-reserved at the end of its lifetime, counted in reservations.
+	 */
+	std::vector<TraceOperation> generate_lifetime_trace( int reservation_count )
+	{
+		struct PendingFree
+		{
+			int end_index;
+			int index;
+
+			bool operator>( const PendingFree& other ) const { return end_index > other.end_index; }
+		};
+
+		std::mt19937 random( 1337 );
+		std::uniform_int_distribution<int> percent( 0, 99 );
+		std::uniform_int_distribution<uint32_t> transient_size( 64, 2048 );
+		std::uniform_int_distribution<uint32_t> long_lived_size( 16, 256 );
+		std::uniform_int_distribution<int> transient_lifetime( 1, 64 );
+		std::uniform_int_distribution<int> long_lived_lifetime( reservation_count * 4 / 5, reservation_count * 8 );
+
+		std::priority_queue<PendingFree, std::vector<PendingFree>, std::greater<PendingFree>> pending_frees {};
+		std::vector<TraceOperation> trace {};
+		trace.reserve( reservation_count * 2 );
+		for ( int i = 0; i < reservation_count; i++ )
+		{
+			while ( !pending_frees.empty() && pending_frees.top().end_index <= i )
+			{
+				TraceOperation operation {};
+				operation.is_reserve = false;
+				operation.index = pending_frees.top().index;
+				trace.push_back( operation );
+				pending_frees.pop();
+			}
+
+			TraceOperation operation {};
+			operation.index = i;
+
+			int lifetime = 0;
+			if ( percent( random ) < 5 )
+			{
+				operation.size = long_lived_size( random );
+				operation.lifetime = FreelistLifetime::LongLived;
+				lifetime = long_lived_lifetime( random );
+			}
+			else
+			{
+				operation.size = transient_size( random );
+				operation.lifetime = FreelistLifetime::Transient;
+				lifetime = transient_lifetime( random );
+			}
+			trace.push_back( operation );
+			pending_frees.push( PendingFree { i + lifetime, i } );
+		}
+
+		return trace;
+	}
+
+	/*
+	 * Replays the trace on a new freelist, with or without its lifetime hints, and prints the peak
+	 * fragmentation and the failed reservations of each lifetime.
+	 */
+	void replay_lifetime_trace( const std::vector<TraceOperation>& trace, int reservation_count, uint32_t data_size, bool should_use_hints )
+	{
+		const int SAMPLE_INTERVAL = 256;
+		const uint32_t INVALID_OFFSET = UINT32_MAX;
+
+		Freelist freelist( data_size );
+		std::vector<uint32_t> offsets( reservation_count, INVALID_OFFSET );
+		std::vector<uint32_t> sizes( reservation_count, 0 );
+
+		float peak_fragmentation = 0.0f;
+		int peak_free_block_count = 0;
+		//  Indexed by the trace lifetimes, whenever the hints are used or not
+		int failure_counts[FREELIST_LIFETIME_COUNT] {};
+
+		Benchmark benchmark {};
+		benchmark.start();
+		for ( size_t i = 0; i < trace.size(); i++ )
+		{
+			const TraceOperation& operation = trace[i];
+			if ( operation.is_reserve )
+			{
+				const FreelistLifetime lifetime = should_use_hints ? operation.lifetime : FreelistLifetime::Normal;
+				if ( freelist.reserve( operation.size, offsets[operation.index], lifetime ) == FreelistError::None )
+				{
+					sizes[operation.index] = operation.size;
+				}
+				else
+				{
+					offsets[operation.index] = INVALID_OFFSET;
+					failure_counts[(int)operation.lifetime]++;
+				}
+			}
+			else if ( offsets[operation.index] != INVALID_OFFSET )
+			{
+				freelist.unreserve( offsets[operation.index], sizes[operation.index] );
+			}
+
+			if ( i % SAMPLE_INTERVAL == 0 )
+			{
+				const FreelistStats stats = freelist.get_stats();
+				peak_fragmentation = std::max( peak_fragmentation, stats.get_fragmentation() );
+				peak_free_block_count = std::max( peak_free_block_count, stats.free_block_count );
+			}
+		}
+		benchmark.stop();
+
+		printf(
+			"Benchmark: lifetimes: %s: %.3f seconds, peak fragmentation %.1f%%, peak %d free blocks, %d %s and %d %s failed reservations\n",
+			should_use_hints ? "with hints" : "without hints",
+			benchmark.get_seconds(),
+			peak_fragmentation * 100.0f,
+			peak_free_block_count,
+			failure_counts[(int)FreelistLifetime::Transient],
+			freelist_lifetime_to_str( FreelistLifetime::Transient ),
+			failure_counts[(int)FreelistLifetime::LongLived],
+			freelist_lifetime_to_str( FreelistLifetime::LongLived )
+		);
+	}
+
+#ifndef _WIN32
+	/*
+	 * Writes or reads the whole buffer through the pipe descriptor, returns false if it was closed.
+	 */
+	bool write_all( int descriptor, const void* buffer, size_t size )
+	{
+		const char* bytes = (const char*)buffer;
+		while ( size > 0 )
+		{
+			const ssize_t count = write( descriptor, bytes, size );
+			if ( count <= 0 ) return false;
+
+			bytes += count;
+			size -= (size_t)count;
+		}
+		return true;
+	}
+
+	bool read_all( int descriptor, void* buffer, size_t size )
+	{
+		char* bytes = (char*)buffer;
+		while ( size > 0 )
+		{
+			const ssize_t count = read( descriptor, bytes, size );
+			if ( count <= 0 ) return false;
+
+			bytes += count;
+			size -= (size_t)count;
+		}
+		return true;
+	}
+
+	/*
+	 * Waits for all child processes, returns false if any of them failed.
+	 */
+	bool wait_children( int count )
+	{
+		bool is_successful = true;
+		for ( int i = 0; i < count; i++ )
+		{
+			int status = 0;
+			if ( wait( &status ) == -1 || !WIFEXITED( status ) || WEXITSTATUS( status ) != 0 )
+			{
+				is_successful = false;
+			}
+		}
+		return is_successful;
+	}
+
+	/*
+	 * Child process body: keeps a window of blocks alive in the shared freelist, replacing
+	 * the oldest one on every iteration. Returns the process exit code.
+	 */
+	int run_shared_churn( const char* name, int iterations, uint32_t seed )
+	{
+		const int WINDOW_SIZE = 64;
+
+		Freelist freelist {};
+		if ( !freelist.open_shared( name ) ) return 1;
+
+		std::mt19937 random( seed );
+		std::uniform_int_distribution<uint32_t> size_distribution( 16, 512 );
+
+		uint32_t offsets[WINDOW_SIZE] {};
+		uint32_t sizes[WINDOW_SIZE] {};
+		for ( int i = 0; i < iterations; i++ )
+		{
+			const int slot = i % WINDOW_SIZE;
+			if ( sizes[slot] > 0 )
+			{
+				freelist.unreserve( offsets[slot], sizes[slot] );
+				sizes[slot] = 0;
+			}
+
+			const uint32_t size = size_distribution( random );
+			if ( freelist.reserve( size, offsets[slot] ) == FreelistError::None )
+			{
+				sizes[slot] = size;
+				memset( freelist.pointer_to_memory( offsets[slot] ), (int)seed, size );
+			}
+		}
+
+		for ( int slot = 0; slot < WINDOW_SIZE; slot++ )
+		{
+			if ( sizes[slot] > 0 )
+			{
+				freelist.unreserve( offsets[slot], sizes[slot] );
+			}
+		}
+		return 0;
+	}
+#endif
+}
+
+namespace benchmarks
+{
+	void run_entity_benchmark( int iterations )
+	{
+		Benchmark benchmark {};
+
+		//  Benchmarking the new/delete operations
+		benchmark.start();
+		for ( int i = 0; i < iterations; i++ )
+		{
+			auto entity = new ExpensiveEntity();
+			entity->is_alive = false;
+			delete entity;
+		}
+		benchmark.stop();
+		printf( "Benchmark: new(): %.3f seconds for a total of %d iterations\n", benchmark.get_seconds(), iterations );
+
+		//  Benchmarking the freelist allocate/free operations
+		Freelist freelist( 2048 );
+		benchmark.start();
+		for ( int i = 0; i < iterations; i++ )
+		{
+			uint32_t size = sizeof( ExpensiveEntity );
+			uint32_t offset;
+			if ( freelist.reserve( size, offset ) == FreelistError::None )
+			{
+				auto entity = (ExpensiveEntity*)freelist.pointer_to_memory( offset );
+				entity->is_alive = false;
+				freelist.unreserve( offset, size );
+			}
+		}
+		benchmark.stop();
+		printf( "Benchmark: freelist: %.3f seconds for a total of %d iterations\n", benchmark.get_seconds(), iterations );
+	}
+
+	void run_slab_benchmark( int iterations )
+	{
+		const uint32_t DATA_SIZE = 4 * 1024 * 1024;
+		const int MAX_LIVE = 4096;
+
+		//  Freelist alone
+		{
+			Freelist freelist( DATA_SIZE );
+			Probe::reset_all();
+
+			const ChurnResult result = run_churn( freelist, iterations, MAX_LIVE );
+			printf(
+				"Benchmark: freelist churn: %.3f seconds for a total of %d iterations (%.2f Mops/s), %d failed reservations\n",
+				result.seconds,
+				iterations,
+				iterations / result.seconds / 1000000.0f,
+				result.failures
+			);
+			print_fragmentation( "freelist churn", freelist );
+			Probe::print_all();
+		}
+
+		//  Slabs in front of the freelist
+		{
+			Freelist freelist( DATA_SIZE );
+			SlabAllocator allocator( freelist );
+
+			const ChurnResult result = run_churn( allocator, iterations, MAX_LIVE );
+			printf(
+				"Benchmark: slab churn: %.3f seconds for a total of %d iterations (%.2f Mops/s), %d failed reservations, %d slabs\n",
+				result.seconds,
+				iterations,
+				iterations / result.seconds / 1000000.0f,
+				result.failures,
+				allocator.get_slab_count()
+			);
+			print_fragmentation( "slab churn", freelist );
+			printf(
+				"Benchmark: slab churn: %s unused inside slabs\n",
+				utils::bytes_to_str( allocator.get_slab_free_size() )
+			);
+		}
+
+		//  Slabs in front of a freelist starting small and growing on demand
+		{
+			Freelist freelist( DATA_SIZE / 16 );
+			freelist.set_out_of_memory_handler( grow_on_out_of_memory );
+			SlabAllocator allocator( freelist );
+
+			const ChurnResult result = run_churn( allocator, iterations, MAX_LIVE );
+			printf(
+				"Benchmark: growing slab churn: %.3f seconds for a total of %d iterations (%.2f Mops/s), %d failed reservations, %d slabs, grown to %s\n",
+				result.seconds,
+				iterations,
+				iterations / result.seconds / 1000000.0f,
+				result.failures,
+				allocator.get_slab_count(),
+				utils::bytes_to_str( freelist.get_data_size() )
+			);
+			print_fragmentation( "growing slab churn", freelist );
+		}
+	}
+
+	void run_persistence_benchmark( int entity_count )
+	{
+		const char* SNAPSHOT_PATH = "freelist_snapshot.bin";
+		const uint32_t ENTITY_SIZE = sizeof( CheaperEntity );
+
+		Benchmark benchmark {};
+
+		//  Cold rebuild: allocate, reserve and fill every entity
+		benchmark.start();
+		Freelist freelist( ENTITY_SIZE * entity_count );
+		for ( int i = 0; i < entity_count; i++ )
+		{
+			uint32_t offset = 0;
+			if ( freelist.reserve( ENTITY_SIZE, offset ) != FreelistError::None ) break;
+
+			memset( freelist.pointer_to_memory( offset ), i & 0xFF, ENTITY_SIZE );
+		}
+		benchmark.stop();
+		printf(
+			"Benchmark: cold rebuild: %.3f seconds for a total of %d entities (%s)\n",
+			benchmark.get_seconds(),
+			entity_count,
+			utils::bytes_to_str( freelist.get_total_size() )
+		);
+
+		benchmark.start();
+		const bool is_saved = freelist.save( SNAPSHOT_PATH );
+		benchmark.stop();
+		if ( !is_saved )
+		{
+			printf( "Benchmark: failed to save the snapshot to '%s'\n", SNAPSHOT_PATH );
+			return;
+		}
+		printf( "Benchmark: save: %.3f seconds\n", benchmark.get_seconds() );
+
+		//  Warm restarts
+		{
+			Freelist restored {};
+			benchmark.start();
+			const bool is_loaded = restored.load( SNAPSHOT_PATH, true );
+			benchmark.stop();
+			printf( "Benchmark: restore with checksum: %.3f seconds, %s\n", benchmark.get_seconds(), is_loaded ? "loaded" : "failed" );
+		}
+		{
+			Freelist restored {};
+			benchmark.start();
+			const bool is_loaded = restored.load( SNAPSHOT_PATH, false );
+			benchmark.stop();
+			printf( "Benchmark: restore without checksum: %.3f seconds, %s\n", benchmark.get_seconds(), is_loaded ? "loaded" : "failed" );
+		}
+
+		remove( SNAPSHOT_PATH );
+	}
+
+	void run_shared_benchmark( int iterations )
+	{
+#ifndef _WIN32
+		const uint32_t DATA_SIZE = 4 * 1024 * 1024;
+		const int MAX_PROCESS_COUNT = 4;
+		const uint32_t MESSAGE_SIZE = 64 * 1024;
+		const int MESSAGE_COUNT = iterations / 100;
+
+		char name[64];
+		snprintf( name, sizeof( name ), "/cpp-freelist-benchmark-%d", (int)getpid() );
+
+		Benchmark benchmark {};
+
+		//  Reserve/unreserve throughput, the same total amount of operations split across processes
+		for ( int process_count = 1; process_count <= MAX_PROCESS_COUNT; process_count *= 2 )
+		{
+			Freelist freelist {};
+			if ( !freelist.create_shared( name, DATA_SIZE ) )
+			{
+				printf( "Benchmark: failed to create the shared memory segment '%s'\n", name );
+				return;
+			}
+
+			benchmark.start();
+			for ( int i = 0; i < process_count; i++ )
+			{
+				if ( fork() == 0 )
+				{
+					_exit( run_shared_churn( name, iterations / process_count, 1337 + i ) );
+				}
+			}
+			const bool is_successful = wait_children( process_count );
+			benchmark.stop();
+
+			printf(
+				"Benchmark: shared churn with %d processes: %.3f seconds for a total of %d iterations (%.2f Mops/s), %s, %s left reserved\n",
+				process_count,
+				benchmark.get_seconds(),
+				iterations,
+				iterations / benchmark.get_seconds() / 1000000.0f,
+				is_successful ? "succeeded" : "failed",
+				utils::bytes_to_str( freelist.get_data_size() - freelist.get_free_size() )
+			);
+
+			Freelist::unlink_shared( name );
+		}
+
+		//  Producer/consumer handing payloads over through the shared freelist: only offsets go through the pipe
+		{
+			Freelist freelist {};
+			int descriptors[2];
+			if ( !freelist.create_shared( name, DATA_SIZE ) || pipe( descriptors ) != 0 )
+			{
+				printf( "Benchmark: failed to create the shared memory segment '%s'\n", name );
+				Freelist::unlink_shared( name );
+				return;
+			}
+
+			benchmark.start();
+			if ( fork() == 0 )
+			{
+				close( descriptors[0] );
+				for ( int i = 0; i < MESSAGE_COUNT; i++ )
+				{
+					//  Wait for the consumer to free some space
+					uint32_t offset = 0;
+					while ( freelist.reserve( MESSAGE_SIZE, offset ) != FreelistError::None )
+					{
+						sched_yield();
+					}
+
+					memset( freelist.pointer_to_memory( offset ), i & 0xFF, MESSAGE_SIZE );
+					if ( !write_all( descriptors[1], &offset, sizeof( offset ) ) ) _exit( 1 );
+				}
+				_exit( 0 );
+			}
+			close( descriptors[1] );
+
+			int received_count = 0;
+			uint32_t offset = 0;
+			while ( read_all( descriptors[0], &offset, sizeof( offset ) ) )
+			{
+				const unsigned char* payload = (const unsigned char*)freelist.pointer_to_memory( offset );
+				if ( payload[MESSAGE_SIZE - 1] == ( received_count & 0xFF ) )
+				{
+					received_count++;
+				}
+				freelist.unreserve( offset, MESSAGE_SIZE );
+			}
+			close( descriptors[0] );
+			wait_children( 1 );
+			benchmark.stop();
+
+			printf(
+				"Benchmark: shared handoff: %.3f seconds for %d/%d messages of %s\n",
+				benchmark.get_seconds(),
+				received_count,
+				MESSAGE_COUNT,
+				utils::bytes_to_str( MESSAGE_SIZE )
+			);
+
+			Freelist::unlink_shared( name );
+		}
+
+		//  Producer/consumer copying payloads through the pipe
+		{
+			int descriptors[2];
+			if ( pipe( descriptors ) != 0 ) return;
+
+			benchmark.start();
+			if ( fork() == 0 )
+			{
+				close( descriptors[0] );
+				std::vector<unsigned char> payload( MESSAGE_SIZE );
+				for ( int i = 0; i < MESSAGE_COUNT; i++ )
+				{
+					memset( payload.data(), i & 0xFF, MESSAGE_SIZE );
+					if ( !write_all( descriptors[1], payload.data(), MESSAGE_SIZE ) ) _exit( 1 );
+				}
+				_exit( 0 );
+			}
+			close( descriptors[1] );
+
+			int received_count = 0;
+			std::vector<unsigned char> payload( MESSAGE_SIZE );
+			while ( read_all( descriptors[0], payload.data(), MESSAGE_SIZE ) )
+			{
+				if ( payload[MESSAGE_SIZE - 1] == ( received_count & 0xFF ) )
+				{
+					received_count++;
+				}
+			}
+			close( descriptors[0] );
+			wait_children( 1 );
+			benchmark.stop();
+
+			printf(
+				"Benchmark: pipe copy: %.3f seconds for %d/%d messages of %s\n",
+				benchmark.get_seconds(),
+				received_count,
+				MESSAGE_COUNT,
+				utils::bytes_to_str( MESSAGE_SIZE )
+			);
+		}
+#else
+		printf( "Benchmark: shared freelists need POSIX shared memory, skipping\n" );
+#endif
+	}
+
+	void run_transaction_benchmark( int iterations )
+	{
+		const uint32_t DATA_SIZE = 4 * 1024 * 1024;
+		const int TRANSACTION_SIZE = 1000;
+		const int transaction_count = std::max( iterations / TRANSACTION_SIZE, 1 );
+
+		Freelist freelist( DATA_SIZE );
+		fragment( freelist, 8192 );
+
+		const FreelistStats initial_stats = freelist.get_stats();
+		printf(
+			"Benchmark: transactions: %d transactions of %d reservations, starting with %d free blocks\n",
+			transaction_count,
+			TRANSACTION_SIZE,
+			initial_stats.free_block_count
+		);
+
+		std::vector<uint32_t> offsets( TRANSACTION_SIZE );
+		std::vector<uint32_t> sizes( TRANSACTION_SIZE );
+
+		//  Same speculative reservations for both strategies
+		std::mt19937 random( 1337 );
+		std::uniform_int_distribution<uint32_t> size_distribution( 16, 256 );
+		for ( int i = 0; i < TRANSACTION_SIZE; i++ )
+		{
+			sizes[i] = size_distribution( random );
+		}
+
+		Benchmark benchmark {};
+
+		//  Un-reserving one by one
+		int64_t undo_time = 0;
+		for ( int transaction = 0; transaction < transaction_count; transaction++ )
+		{
+			for ( int i = 0; i < TRANSACTION_SIZE; i++ )
+			{
+				freelist.reserve( sizes[i], offsets[i] );
+			}
+
+			benchmark.start();
+			for ( int i = 0; i < TRANSACTION_SIZE; i++ )
+			{
+				freelist.unreserve( offsets[i], sizes[i] );
+			}
+			benchmark.stop();
+			undo_time += benchmark.get_nano_seconds();
+		}
+
+		FreelistStats stats = freelist.get_stats();
+		printf(
+			"Benchmark: transactions: unreserve: %.3f seconds, %.1f us per transaction, %s\n",
+			undo_time / 1000000000.0f,
+			undo_time / 1000.0f / transaction_count,
+			stats.free_size == initial_stats.free_size && stats.free_block_count == initial_stats.free_block_count ? "restored" : "NOT restored"
+		);
+
+		//  Rolling back to a checkpoint
+		undo_time = 0;
+		for ( int transaction = 0; transaction < transaction_count; transaction++ )
+		{
+			const FreelistCheckpoint checkpoint = freelist.checkpoint();
+			for ( int i = 0; i < TRANSACTION_SIZE; i++ )
+			{
+				freelist.reserve( sizes[i], offsets[i] );
+			}
+
+			benchmark.start();
+			freelist.rollback( checkpoint );
+			benchmark.stop();
+			undo_time += benchmark.get_nano_seconds();
+		}
+
+		stats = freelist.get_stats();
+		printf(
+			"Benchmark: transactions: rollback: %.3f seconds, %.1f us per transaction, %s\n",
+			undo_time / 1000000000.0f,
+			undo_time / 1000.0f / transaction_count,
+			stats.free_size == initial_stats.free_size && stats.free_block_count == initial_stats.free_block_count ? "restored" : "NOT restored"
+		);
+	}
+
+	void run_deferred_free_benchmark( int iterations )
+	{
+		const uint32_t DATA_SIZE = 4 * 1024 * 1024;
+		const int BURST_SIZE = 1000;
+		const int burst_count = std::max( iterations / BURST_SIZE, 1 );
+
+		std::vector<uint32_t> sizes( BURST_SIZE );
+		std::vector<uint32_t> offsets( BURST_SIZE );
+		std::vector<int> order( BURST_SIZE );
+		std::vector<uint64_t> latencies {};
+		latencies.reserve( (size_t)burst_count * BURST_SIZE );
+
+		for ( int is_deferred = 0; is_deferred < 2; is_deferred++ )
+		{
+			Freelist freelist( DATA_SIZE );
+			fragment( freelist, 8192 );
+			//  Large enough for the flush to only happen at the end of the bursts
+			freelist.set_deferred_free( is_deferred ? BURST_SIZE * 2 : 0 );
+
+			const FreelistStats initial_stats = freelist.get_stats();
+
+			//  Same bursts for both strategies
+			std::mt19937 random( 1337 );
+			std::uniform_int_distribution<uint32_t> size_distribution( 16, 256 );
+
+			latencies.clear();
+			int64_t flush_time = 0;
+			Benchmark benchmark {};
+			for ( int burst = 0; burst < burst_count; burst++ )
+			{
+				for ( int i = 0; i < BURST_SIZE; i++ )
+				{
+					sizes[i] = size_distribution( random );
+					freelist.reserve( sizes[i], offsets[i] );
+					order[i] = i;
+				}
+				std::shuffle( order.begin(), order.end(), random );
+
+				for ( int i = 0; i < BURST_SIZE; i++ )
+				{
+					const int index = order[i];
+					const uint64_t start = Probe::now_ticks();
+					freelist.unreserve( offsets[index], sizes[index] );
+					latencies.push_back( Probe::ticks_to_nano_seconds( Probe::now_ticks() - start ) );
+				}
+
+				//  End of the burst, like the end of a frame or a request
+				benchmark.start();
+				freelist.flush();
+				benchmark.stop();
+				flush_time += benchmark.get_nano_seconds();
+			}
+
+			const FreelistStats stats = freelist.get_stats();
+			printf(
+				"Benchmark: deferred free: %s: %d bursts of %d un-reservations, starting with %d free blocks, flush %.1f us per burst, %s\n",
+				is_deferred ? "deferred" : "immediate",
+				burst_count,
+				BURST_SIZE,
+				initial_stats.free_block_count,
+				flush_time / 1000.0f / burst_count,
+				stats.free_size == initial_stats.free_size && stats.free_block_count == initial_stats.free_block_count ? "restored" : "NOT restored"
+			);
+			print_latencies( is_deferred ? "deferred free: deferred unreserve" : "deferred free: immediate unreserve", latencies );
+		}
+	}
+
+	void run_lifetime_benchmark( int iterations )
+	{
+		const int reservation_count = std::max( iterations / 4, 1000 );
+		//  Long-lived objects average 136 bytes and most of them outlive the trace, filling most of the memory by its end
+		const uint32_t data_size = reservation_count * 27 / 4;
+
+		const std::vector<TraceOperation> trace = generate_lifetime_trace( reservation_count );
+		printf(
+			"Benchmark: lifetimes: replaying %d reservations, 95%% transient and 5%% long-lived, in %s\n",
+			reservation_count,
+			utils::bytes_to_str( data_size )
+		);
+
+		replay_lifetime_trace( trace, reservation_count, data_size, false );
+		replay_lifetime_trace( trace, reservation_count, data_size, true );
+	}
+
+	void run_entity_store_benchmark( int entity_count )
+	{
+		const int CHURN_ROUND_COUNT = 4;
+		const int UPDATE_COUNT = 10;
+		const float DT = 1.0f / 60.0f;
+
+		EntityStore<CheaperEntity> store( entity_count );
+		if ( !store.is_valid() )
+		{
+			printf( "Benchmark: entity store: failed to allocate %d entities, skipping\n", entity_count );
+			return;
+		}
+
+		//  Entities are also tracked in creation order, and by the registry like the application does
+		std::vector<CheaperEntity*> entities {};
+		std::vector<ReservationId> ids {};
+		entities.reserve( entity_count );
+		ids.reserve( entity_count );
+		ReservationRegistry registry {};
+
+		const char* memory = (const char*)store.get_freelist().pointer_to_memory( 0 );
+		auto create = [&]()
+		{
+			CheaperEntity* entity = store.create();
+			entity->size = Vector2 { 1.0f, 1.0f };
+
+			Reservation reservation {};
+			reservation.offset = (uint32_t)( (const char*)entity - memory );
+			reservation.size = sizeof( CheaperEntity );
+			reservation.data = entity;
+
+			entities.push_back( entity );
+			ids.push_back( registry.add( reservation ) );
+		};
+
+		for ( int i = 0; i < entity_count; i++ )
+		{
+			create();
+		}
+
+		//  Destroy a random quarter of the entities and create new ones in the holes, a few times,
+		//  so that the creation order doesn't follow the addresses anymore
+		std::mt19937 random( 1337 );
+		for ( int round = 0; round < CHURN_ROUND_COUNT; round++ )
+		{
+			for ( int i = 0; i < entity_count / 4; i++ )
+			{
+				std::uniform_int_distribution<size_t> pick( 0, entities.size() - 1 );
+				const size_t index = pick( random );
+
+				store.destroy( entities[index] );
+				registry.remove( ids[index] );
+
+				entities[index] = entities.back();
+				entities.pop_back();
+				ids[index] = ids.back();
+				ids.pop_back();
+			}
+
+			for ( int i = 0; i < entity_count / 4; i++ )
+			{
+				create();
+			}
+		}
+
+		auto update = [DT]( CheaperEntity& entity )
+		{
+			entity.pos.x += entity.size.x * DT;
+			entity.pos.y += entity.size.y * DT;
+		};
+
+		Benchmark benchmark {};
+		int visited_count = 0;
+
+		//  Creation order
+		benchmark.start();
+		for ( int i = 0; i < UPDATE_COUNT; i++ )
+		{
+			for ( CheaperEntity* entity : entities )
+			{
+				update( *entity );
+			}
+		}
+		benchmark.stop();
+		printf(
+			"Benchmark: entity store: %d entities in creation order: %.2f ms per update\n",
+			(int)entities.size(),
+			benchmark.get_seconds() * 1000.0f / UPDATE_COUNT
+		);
+
+		//  Registry, in offset order
+		visited_count = 0;
+		benchmark.start();
+		for ( int i = 0; i < UPDATE_COUNT; i++ )
+		{
+			registry.visit_range( 0, store.get_freelist().get_data_size(), [&]( ReservationId, const Reservation& reservation )
+			{
+				update( *(CheaperEntity*)reservation.data );
+				visited_count++;
+			} );
+		}
+		benchmark.stop();
+		printf(
+			"Benchmark: entity store: %d entities through the registry: %.2f ms per update\n",
+			visited_count / UPDATE_COUNT,
+			benchmark.get_seconds() * 1000.0f / UPDATE_COUNT
+		);
+
+		//  Store, in address order
+		visited_count = 0;
+		benchmark.start();
+		for ( int i = 0; i < UPDATE_COUNT; i++ )
+		{
+			store.for_each( [&]( CheaperEntity& entity )
+			{
+				update( entity );
+				visited_count++;
+			} );
+		}
+		benchmark.stop();
+		printf(
+			"Benchmark: entity store: %d entities through the store: %.2f ms per update\n",
+			visited_count / UPDATE_COUNT,
+			benchmark.get_seconds() * 1000.0f / UPDATE_COUNT
+		);
+	}
+
+	void run_cache_placement_benchmark( int iterations )
+	{
+		//  Threads updating particles of their own, interleaved in memory
+		{
+			struct Particle
+			{
+				float x = 0.0f;
+				float y = 0.0f;
+				float vx = 1.0f;
+				float vy = 1.0f;
+			};
+
+			const int THREAD_COUNT = 4;
+			const int PARTICLES_PER_THREAD = 64;
+			const float DT = 1.0f / 60.0f;
+			const int pass_count = std::max( iterations / PARTICLES_PER_THREAD, 1 );
+
+			for ( int is_isolated = 0; is_isolated < 2; is_isolated++ )
+			{
+				Freelist freelist( 1024 * 1024 );
+
+				std::vector<std::vector<Particle*>> particles( THREAD_COUNT );
+				for ( int i = 0; i < PARTICLES_PER_THREAD * THREAD_COUNT; i++ )
+				{
+					uint32_t offset = 0;
+					const FreelistError error = is_isolated
+						? freelist.reserve_isolated( sizeof( Particle ), offset )
+						: freelist.reserve( sizeof( Particle ), offset );
+					if ( error != FreelistError::None ) break;
+
+					particles[i % THREAD_COUNT].push_back( new ( freelist.pointer_to_memory( offset ) ) Particle() );
+				}
+
+				Benchmark benchmark {};
+				benchmark.start();
+
+				std::vector<std::thread> threads {};
+				for ( int thread = 0; thread < THREAD_COUNT; thread++ )
+				{
+					threads.emplace_back( [&particles, thread, pass_count, DT]()
+					{
+						for ( int pass = 0; pass < pass_count; pass++ )
+						{
+							for ( Particle* particle : particles[thread] )
+							{
+								particle->x += particle->vx * DT;
+								particle->y += particle->vy * DT;
+							}
+						}
+					} );
+				}
+				for ( std::thread& thread : threads )
+				{
+					thread.join();
+				}
+
+				benchmark.stop();
+
+				const float update_count = (float)pass_count * PARTICLES_PER_THREAD * THREAD_COUNT;
+				printf(
+					"Benchmark: cache placement: %d threads %s: %.1f M particle updates per second (%d threads available)\n",
+					THREAD_COUNT,
+					is_isolated ? "with isolated particles" : "with packed particles",
+					update_count / benchmark.get_seconds() / 1000000.0f,
+					(int)std::thread::hardware_concurrency()
+				);
+			}
+		}
+
+		//  Reading the start of many large buffers
+		{
+			const int BUFFER_COUNT = 64;
+			const uint32_t BUFFER_SIZE = 16 * 1024;
+			const uint32_t READ_SIZE = 256;
+			const int pass_count = std::max( iterations / 100, 1 );
+
+			for ( int is_coloured = 0; is_coloured < 2; is_coloured++ )
+			{
+				Freelist freelist( 2 * BUFFER_COUNT * BUFFER_SIZE );
+				freelist.set_cache_colouring( is_coloured ? BUFFER_SIZE : 0 );
+
+				std::vector<const uint64_t*> buffers {};
+				for ( int i = 0; i < BUFFER_COUNT; i++ )
+				{
+					uint32_t offset = 0;
+					if ( freelist.reserve( BUFFER_SIZE, offset ) != FreelistError::None ) break;
+
+					buffers.push_back( (const uint64_t*)freelist.pointer_to_memory( offset ) );
+				}
+
+				uint64_t sum = 0;
+				Benchmark benchmark {};
+				benchmark.start();
+				for ( int pass = 0; pass < pass_count; pass++ )
+				{
+					for ( const uint64_t* buffer : buffers )
+					{
+						for ( uint32_t i = 0; i < READ_SIZE / sizeof( uint64_t ); i += FREELIST_CACHE_LINE_SIZE / sizeof( uint64_t ) )
+						{
+							sum += buffer[i];
+						}
+					}
+				}
+				benchmark.stop();
+
+				//  Keep the reads from being optimized out
+				volatile uint64_t result = sum;
+				(void)result;
+
+				printf(
+					"Benchmark: cache placement: reading the first %s of %d buffers of %s %s: %.1f ns per pass\n",
+					utils::bytes_to_str( READ_SIZE ),
+					(int)buffers.size(),
+					utils::bytes_to_str( BUFFER_SIZE ),
+					is_coloured ? "with colouring" : "without colouring",
+					benchmark.get_nano_seconds() / (float)pass_count
+				);
+			}
+		}
+
+		//  Filling an arena sized for the buffers, colouring must not leave a stride between them
+		{
+			const int BUFFER_COUNT = 64;
+			const uint32_t BUFFER_SIZE = 16 * 1024;
+
+			for ( int lifetime = 0; lifetime < 3; lifetime++ )
+			{
+				Freelist freelist( BUFFER_COUNT * BUFFER_SIZE );
+				freelist.set_cache_colouring( BUFFER_SIZE );
+
+				int buffer_count = 0;
+				for ( int i = 0; i < BUFFER_COUNT; i++ )
+				{
+					uint32_t offset = 0;
+					if ( freelist.reserve( BUFFER_SIZE, offset, (FreelistLifetime)lifetime ) != FreelistError::None ) break;
+
+					buffer_count++;
+				}
+
+				char name[64];
+				snprintf( name, sizeof( name ), "coloured %s fill", freelist_lifetime_to_str( (FreelistLifetime)lifetime ) );
+				printf(
+					"Benchmark: cache placement: %s: %d of %d buffers of %s fit\n",
+					name,
+					buffer_count,
+					BUFFER_COUNT,
+					utils::bytes_to_str( BUFFER_SIZE )
+				);
+				print_fragmentation( name, freelist );
+			}
+		}
+	}
+}
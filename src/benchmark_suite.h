@@ -0,0 +1,54 @@
+#pragma once
+
+/*
+ * Benchmarks comparing the freelist and its front-ends against other allocation strategies.
+ * Results are printed to the standard output.
+ */
+namespace benchmarks
+{
+	/*
+	 * Compares new/delete against freelist reserve/unreserve for a single ExpensiveEntity.
+	 */
+	void run_entity_benchmark( int iterations );
+	/*
+	 * Compares the throughput and fragmentation of the slab allocator against the freelist alone,
+	 * using a random mix of CheaperEntity and ExpensiveEntity reservations and un-reservations.
+	 */
+	void run_slab_benchmark( int iterations );
+	/*
+	 * Compares restoring a freelist holding the given amount of CheaperEntity from a snapshot file,
+	 * with and without checksum verification, against rebuilding it from scratch.
+	 */
+	void run_persistence_benchmark( int entity_count );
+	/*
+	 * Measures the reserve/unreserve throughput of a shared freelist used by several processes at
+	 * once, and compares handing payloads over through a shared freelist against copying them
+	 * through a pipe. Only available with POSIX shared memory.
+	 */
+	void run_shared_benchmark( int iterations );
+	/*
+	 * Compares undoing batches of 1K speculative reservations by un-reserving them one by one
+	 * against rolling the freelist back to a checkpoint.
+	 */
+	void run_transaction_benchmark( int iterations );
+	/*
+	 * Compares the latency of un-reserving bursts of blocks in a random order immediately against
+	 * deferring them until a flush at the end of each burst.
+	 */
+	void run_deferred_free_benchmark( int iterations );
+	/*
+	 * Replays a trace mixing transient and long-lived reservations with and without lifetime hints,
+	 * comparing the peak fragmentation and the failed reservations.
+	 */
+	void run_lifetime_benchmark( int iterations );
+	/*
+	 * Compares updating the given amount of CheaperEntity in creation order, through a reservation
+	 * registry and through an entity store sweeping them in address order.
+	 */
+	void run_entity_store_benchmark( int entity_count );
+	/*
+	 * Compares several threads updating interleaved particles packed together against isolated in
+	 * their own cache lines, and reading the start of large buffers with and without cache colouring.
+	 */
+	void run_cache_placement_benchmark( int iterations );
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+#include "freelist.h"
+
+/*
+ * Amount of destroyed entities queued before their memory is un-reserved.
+ */
+const uint32_t ENTITY_STORE_DEFERRED_CAPACITY = 4096;
+
+/*
+ * An array of entities of the same type, living in a freelist of their own.
+ * Since every block has the size of an entity, the reserved ranges of the freelist are packed
+ * arrays of entities, which 'for_each' sweeps in address order.
+ * Destroying an entity is deferred and costs constant time, see 'Freelist::set_deferred_free'.
+ */
+template <typename T>
+class EntityStore
+{
+	static_assert( alignof( T ) <= FREELIST_DATA_ALIGNMENT, "EntityStore can't align entities above the freelist data alignment" );
+
+public:
+	/*
+	 * Allocates the memory for the given maximum amount of entities.
+	 * Check 'is_valid' to know whenever the allocation succeeded.
+	 */
+	EntityStore( uint32_t capacity )
+		//  At most every other entity is free between reserved ones, plus a spare node
+		: _freelist( capacity * (uint32_t)sizeof( T ), (int)( ( capacity + 1 ) / 2 + 1 ) )
+	{
+		if ( !_freelist.is_valid() ) return;
+
+		_freelist.set_deferred_free( ENTITY_STORE_DEFERRED_CAPACITY );
+	}
+	/*
+	 * Destroys all entities.
+	 */
+	~EntityStore()
+	{
+		clear();
+	}
+
+	EntityStore( const EntityStore& ) = delete;
+	EntityStore& operator=( const EntityStore& ) = delete;
+
+	/*
+	 * Constructs a new entity with the given arguments.
+	 * Returns nullptr if the store is full.
+	 */
+	template <typename... Args>
+	T* create( Args&&... args )
+	{
+		uint32_t offset = 0;
+		if ( _freelist.reserve( sizeof( T ), offset ) != FreelistError::None ) return nullptr;
+
+		_count++;
+		return new ( _freelist.pointer_to_memory( offset ) ) T( std::forward<Args>( args )... );
+	}
+	/*
+	 * Destructs the entity, which must belong to this store.
+	 */
+	void destroy( T* entity )
+	{
+		const uint32_t offset = (uint32_t)( (char*)entity - (char*)_freelist.pointer_to_memory( 0 ) );
+
+		entity->~T();
+		_freelist.unreserve( offset, sizeof( T ) );
+		_count--;
+	}
+	/*
+	 * Destroys all entities.
+	 */
+	void clear()
+	{
+		if ( !_freelist.is_valid() ) return;
+
+		for_each( []( T& entity ) { entity.~T(); } );
+		_freelist.clear();
+		_count = 0;
+	}
+
+	/*
+	 * Calls 'callback( T& )' for each entity in address order, after flushing the destroyed ones.
+	 * The callback must not create nor destroy entities.
+	 */
+	template <typename Callback>
+	void for_each( Callback callback )
+	{
+		//  Destroyed entities still queued would be visited, the node table is sized so it can't fail
+		const FreelistError error = _freelist.flush();
+		assert( error == FreelistError::None && "EntityStore couldn't flush its destroyed entities" );
+		(void)error;
+
+		_freelist.visit_reserved( [&]( uint32_t offset, uint32_t size )
+		{
+			T* entity = (T*)_freelist.pointer_to_memory( offset );
+			T* const end = entity + size / sizeof( T );
+			for ( ; entity < end; ++entity )
+			{
+				callback( *entity );
+			}
+		} );
+	}
+
+	bool is_valid() const { return _freelist.is_valid(); }
+	int get_count() const { return _count; }
+	uint32_t get_capacity() const { return _freelist.get_data_size() / sizeof( T ); }
+	const Freelist& get_freelist() const { return _freelist; }
+
+private:
+	Freelist _freelist;
+	int _count = 0;
+};
@@ -1,217 +1,635 @@
 #include "freelist.h"
 
+#include <cassert>
+#include <cstdint>
 #include <cstdlib>
-#include <stdio.h>
 #include <cstring>
+#include <new>
 
-#include "utils.h"
+#include "probe.h"
 
-Freelist::Freelist( uint32_t data_size )
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#if FREELIST_ENABLE_STATS
+static int size_to_histogram_bucket( uint32_t size )
 {
-	_data_size = data_size;
+	if ( size == 0 ) return 0;
+
+#ifdef _MSC_VER
+	unsigned long index = 0;
+	_BitScanReverse( &index, size );
+	return (int)index;
+#else
+	return 31 - __builtin_clz( size );
+#endif
+}
+#endif
+
+const char* freelist_error_to_str( FreelistError error )
+{
+	switch ( error )
+	{
+		case FreelistError::None:
+			return "none";
+		case FreelistError::OutOfSpace:
+			return "out of space";
+		case FreelistError::TooFragmented:
+			return "too fragmented";
+		case FreelistError::NodeTableExhausted:
+			return "node table exhausted";
+	}
+
+	return "unknown";
+}
+
+const char* freelist_lifetime_to_str( FreelistLifetime lifetime )
+{
+	switch ( lifetime )
+	{
+		case FreelistLifetime::Normal:
+			return "normal";
+		case FreelistLifetime::Transient:
+			return "transient";
+		case FreelistLifetime::LongLived:
+			return "long-lived";
+	}
+
+	return "unknown";
+}
 
-	//  Maximum amount of nodes to allocate with the smallest possible size
-	//  Division by 4 is kinda arbitrary here, we just don't need much allocated nodes for the example
-	_node_count = _data_size / ( sizeof( void* ) ) / 4;
+#if ENABLE_PROBES
+static Probe reserve_probe( "Freelist::reserve" );
+static Probe unreserve_probe( "Freelist::unreserve" );
+static Probe new_node_probe( "Freelist::_new_node" );
+static Probe clear_probe( "Freelist::clear" );
+#endif
 
+//  Maximum amount of nodes to allocate with the smallest possible size
+//  Division by 4 is kinda arbitrary here, we just don't need much allocated nodes for the example
+Freelist::Freelist( uint32_t data_size )
+	: Freelist( data_size, (int)( data_size / ( sizeof( void* ) ) / 4 ) )
+{}
+
+Freelist::Freelist( uint32_t data_size, int node_count )
+{
 	//  Measure total memory size to allocate
 	//  Memory layout is: 
-	//  - Freelist nodes (Internal size) 
+	//  - Freelist header and nodes (Internal size) 
 	//  - User data (Data size)
-	int nodes_byte = sizeof( FreelistNode ) * _node_count;
-	_internal_size = nodes_byte;
+	_data_size = data_size;
+	_node_count = node_count;
+	_internal_size = _compute_internal_size( node_count );
 	_total_size = _internal_size + _data_size;
 
 	//  Allocating memory
-	_memory = malloc( _total_size );
-	if ( _memory == nullptr )
+	void* memory = malloc( _total_size );
+	if ( memory == nullptr ) return;
+
+	_format_memory( memory, data_size, node_count );
+}
+
+Freelist::Freelist()
+{}
+
+Freelist::~Freelist()
+{
+	stop_flush_thread();
+	_release_memory();
+}
+
+FreelistError Freelist::reserve( uint32_t size, uint32_t& offset, FreelistLifetime lifetime )
+{
+	LockScope lock( *this );
+	PROBE_SCOPE( reserve_probe );
+
+	Placement placement {};
+	placement.lifetime = lifetime;
+
+	//  Stagger the large blocks over the cache sets
+	if ( _cache_colouring_min_size > 0 && size >= _cache_colouring_min_size )
 	{
-		printf(
-			"Freelist failed to allocate memory for a data size of %s, using at maximum %d nodes and for a total size of %s\n",
-			utils::bytes_to_str( _data_size ),
-			_node_count,
-			utils::bytes_to_str( _total_size )
-		);
-		return;
+		//  Step the colour in the direction blocks are carved, so that consecutive blocks only
+		//  leave a cache line between them instead of almost a whole stride
+		const uint32_t colour_count = FREELIST_CACHE_COLOUR_STRIDE / FREELIST_CACHE_LINE_SIZE;
+		uint32_t colour = 0;
+		if ( lifetime == FreelistLifetime::LongLived )
+		{
+			colour = _next_bottom_up_cache_colour;
+			_next_bottom_up_cache_colour = ( colour + 1 ) % colour_count;
+		}
+		else
+		{
+			colour = _next_top_down_cache_colour;
+			_next_top_down_cache_colour = ( colour + colour_count - 1 ) % colour_count;
+		}
+
+		placement.alignment = FREELIST_CACHE_COLOUR_STRIDE;
+		placement.phase = colour * FREELIST_CACHE_LINE_SIZE;
+		placement.is_alignment_optional = true;
 	}
 
-	//  Zero out memory
-	memset( _memory, 0, _total_size );
+	return _reserve_placed( size, offset, placement );
+}
+
+FreelistError Freelist::reserve_aligned( uint32_t size, uint32_t alignment, uint32_t& offset, uint32_t phase )
+{
+	LockScope lock( *this );
+	PROBE_SCOPE( reserve_probe );
 
-	//  Assign nodes pointer to internal memory space
-	_nodes = (FreelistNode*)_memory;
+	Placement placement {};
+	placement.alignment = alignment > 0 ? alignment : 1;
+	placement.phase = phase & ( placement.alignment - 1 );
+	return _reserve_placed( size, offset, placement );
+}
 
-	_head = &_nodes[0];
-	_head->offset = 0;
-	_head->size = _data_size;
-	_head->next = nullptr;
+FreelistError Freelist::reserve_isolated( uint32_t size, uint32_t& offset )
+{
+	//  Rounding up to the cache line would wrap around
+	if ( size > UINT32_MAX - FREELIST_CACHE_LINE_SIZE + 1 ) return FreelistError::OutOfSpace;
 
-	printf(
-		"Freelist was initialized for a data size of %s, using at maximum %d nodes and for a total size of %s\n",
-		utils::bytes_to_str( _data_size ),
-		_node_count,
-		utils::bytes_to_str( _total_size )
-	);
+	return reserve_aligned( get_isolated_size( size ), FREELIST_CACHE_LINE_SIZE, offset );
 }
 
-Freelist::~Freelist()
+uint32_t Freelist::get_isolated_size( uint32_t size )
 {
-	free( _memory );
-	_memory = nullptr;
+	return ( size + FREELIST_CACHE_LINE_SIZE - 1 ) / FREELIST_CACHE_LINE_SIZE * FREELIST_CACHE_LINE_SIZE;
+}
+
+void Freelist::set_cache_colouring( uint32_t min_size )
+{
+	LockScope lock( *this );
+
+	_cache_colouring_min_size = min_size;
+	_next_top_down_cache_colour = 0;
+	_next_bottom_up_cache_colour = 0;
+}
+
+FreelistError Freelist::_reserve_placed( uint32_t size, uint32_t& offset, const Placement& placement )
+{
+	//  No memory? The allocation or the load failed
+	if ( _header == nullptr ) return FreelistError::OutOfSpace;
+
+	const FreelistLifetime lifetime = placement.lifetime;
+
+#if FREELIST_ENABLE_STATS
+	_header->stats.size_histogram[size_to_histogram_bucket( size )]++;
+#endif
+
+	int retry_count = 0;
+	while ( true )
+	{
+		FreelistError error = FreelistError::None;
+		if ( placement.alignment > 1 )
+		{
+			error = _reserve_aligned( size, placement.alignment, placement.phase, lifetime, offset );
+		}
+		if ( placement.alignment <= 1 || ( error != FreelistError::None && placement.is_alignment_optional ) )
+		{
+			error = _reserve( size, offset, lifetime );
+		}
+
+		if ( error == FreelistError::None )
+		{
+#if FREELIST_ENABLE_STATS
+			//  The memory may have moved if the handler grew it
+			FreelistLifetimeStats& lifetime_stats = _header->stats.lifetime_stats[(int)lifetime];
+			lifetime_stats.reserve_count++;
+			lifetime_stats.reserved_size += size;
+#endif
+			return error;
+		}
+
+		//  Deferred blocks may be enough to fit it
+		if ( !_deferred_ranges.empty() && flush() == FreelistError::None ) continue;
+
+		//  Let the handler make some room before giving up
+		const bool should_retry = _out_of_memory_handler
+			&& retry_count < FREELIST_MAX_OUT_OF_MEMORY_RETRIES
+			&& _out_of_memory_handler( *this, error, size, _out_of_memory_user_data );
+		if ( !should_retry )
+		{
+#if FREELIST_ENABLE_STATS
+			_header->stats.failure_count++;
+			_header->stats.lifetime_stats[(int)lifetime].failure_count++;
+#endif
+			return error;
+		}
+
+		retry_count++;
+	}
 }
 
-bool Freelist::reserve( uint32_t size, uint32_t& offset )
+FreelistError Freelist::unreserve( uint32_t offset, uint32_t size )
 {
+	LockScope lock( *this );
+	PROBE_SCOPE( unreserve_probe );
+
+	if ( _header == nullptr ) return FreelistError::OutOfSpace;
+
+	if ( _deferred_capacity > 0 )
+	{
+		_deferred_ranges.push_back( DeferredRange { offset, size } );
+		_deferred_size += size;
+#if FREELIST_ENABLE_STATS
+		_header->stats.unreserve_count++;
+#endif
+
+		if ( _deferred_ranges.size() >= _deferred_capacity )
+		{
+			//  Blocks failing to be inserted stay queued for a later flush
+			flush();
+		}
+		return FreelistError::None;
+	}
+
+	const FreelistError error = _insert_free_range( offset, size );
+	if ( error != FreelistError::None )
+	{
+#if FREELIST_ENABLE_STATS
+		_header->stats.failure_count++;
+#endif
+		return error;
+	}
+
+	//  Zero out memory
+	memset( pointer_to_memory( offset ), 0, size );
+
+#if FREELIST_ENABLE_STATS
+	_header->stats.used_size -= size;
+	_header->stats.unreserve_count++;
+#endif
+	return FreelistError::None;
+}
+
+FreelistError Freelist::_reserve( uint32_t size, uint32_t& offset, FreelistLifetime lifetime )
+{
+	//  Find the first block large enough, or the last one for transient reservations
+	FreelistNode* found_previous = nullptr;
+	int32_t found_link = FREELIST_INVALID_NODE;
+
 	FreelistNode* previous = nullptr;
-	FreelistNode* node = _head;
-	while( node )
+	int32_t link = _header->head;
+	while( link != FREELIST_INVALID_NODE )
 	{
-		if ( node->size == size )
+		FreelistNode* node = _node_at( link );
+		if ( node->size >= size )
 		{
-			if ( previous )
-			{
-				previous->next = node->next;
-			}
-			//  No previous node? It means it's the head
-			else
-			{
-				_head = node->next;
-			}
+			found_previous = previous;
+			found_link = link;
+			if ( lifetime != FreelistLifetime::Transient ) break;
+		}
 
-			offset = node->offset;
+		previous = node;
+		link = node->next;
+	}
 
-			//  Invalidate node
-			node->offset = 0;
-			node->size = 0;
-			node->next = nullptr;
+	if ( found_link == FREELIST_INVALID_NODE )
+	{
+		return _header->free_size >= size ? FreelistError::TooFragmented : FreelistError::OutOfSpace;
+	}
 
-			return true;
+	FreelistNode* node = _node_at( found_link );
+
+#if FREELIST_ENABLE_STATS
+	//  Shrinking the largest node: it may not be the largest anymore
+	if ( node->size == _header->stats.largest_free_size )
+	{
+		_header->is_largest_free_size_dirty = 1;
+	}
+#endif
+
+	if ( node->size == size )
+	{
+		if ( found_previous )
+		{
+			_journal_node( found_previous );
+			found_previous->next = node->next;
 		}
-		else if ( node->size > size )
+		//  No previous node? It means it's the head
+		else
 		{
-			node->size -= size;
+			_header->head = node->next;
+		}
 
+		offset = node->offset;
+
+		//  Invalidate node
+		_delete_node( found_link );
+	}
+	else
+	{
+		_journal_node( node );
+		node->size -= size;
+
+		//  Long-lived reservations grow from the bottom of the memory
+		if ( lifetime == FreelistLifetime::LongLived )
+		{
+			offset = node->offset;
+			node->offset += size;
+		}
+		else
+		{
 			offset = node->offset + node->size;
-			return true;
+		}
+	}
+
+	_on_reserved( size );
+	return FreelistError::None;
+}
+
+FreelistError Freelist::_reserve_aligned( uint32_t size, uint32_t alignment, uint32_t phase, FreelistLifetime lifetime, uint32_t& offset )
+{
+	//  Offsets giving addresses of the requested phase
+	const uint32_t mask = alignment - 1;
+	const uint32_t base = (uint32_t)( (uintptr_t)pointer_to_memory( 0 ) & mask );
+	const uint32_t target = ( phase - base ) & mask;
+
+	//  Find the first block fitting the reservation, or the last one for transient reservations
+	FreelistNode* found_previous = nullptr;
+	int32_t found_link = FREELIST_INVALID_NODE;
+	uint32_t found_candidate = 0;
+
+	FreelistNode* previous = nullptr;
+	int32_t link = _header->head;
+	while( link != FREELIST_INVALID_NODE )
+	{
+		FreelistNode* node = _node_at( link );
+		if ( node->size >= size )
+		{
+			//  Lowest offset of the node with the requested phase for long-lived reservations, the highest
+			//  otherwise, past 'last' or before the node if there is none
+			const uint32_t last = node->offset + node->size - size;
+			const uint32_t candidate = lifetime == FreelistLifetime::LongLived
+				? node->offset + ( ( target - node->offset ) & mask )
+				: last - ( ( last - target ) & mask );
+			if ( candidate >= node->offset && candidate <= last )
+			{
+				found_previous = previous;
+				found_link = link;
+				found_candidate = candidate;
+				if ( lifetime != FreelistLifetime::Transient ) break;
+			}
 		}
 
 		previous = node;
-		node = node->next;
+		link = node->next;
 	}
 
-	printf( 
-		"Freelist couldn't find enough space to hold %s, free space: %s\n", 
-		utils::bytes_to_str( size ), 
-		utils::bytes_to_str( get_free_size() ) 
-	);
-	return false;
+	if ( found_link == FREELIST_INVALID_NODE )
+	{
+		return _header->free_size >= size ? FreelistError::TooFragmented : FreelistError::OutOfSpace;
+	}
+
+	FreelistNode* node = _node_at( found_link );
+	const uint32_t end = node->offset + node->size;
+	const uint32_t head_size = found_candidate - node->offset;
+	const uint32_t tail_size = end - found_candidate - size;
+
+	//  Split the node around the reservation, it keeps the space before it
+	int32_t tail_link = FREELIST_INVALID_NODE;
+	if ( head_size > 0 && tail_size > 0 )
+	{
+		tail_link = _new_node( found_candidate + size, tail_size );
+		if ( tail_link == FREELIST_INVALID_NODE ) return FreelistError::NodeTableExhausted;
+	}
+
+#if FREELIST_ENABLE_STATS
+	//  Shrinking the largest node: it may not be the largest anymore
+	if ( node->size == _header->stats.largest_free_size )
+	{
+		_header->is_largest_free_size_dirty = 1;
+	}
+#endif
+
+	if ( head_size == 0 && tail_size == 0 )
+	{
+		if ( found_previous )
+		{
+			_journal_node( found_previous );
+			found_previous->next = node->next;
+		}
+		//  No previous node? It means it's the head
+		else
+		{
+			_header->head = node->next;
+		}
+
+		_delete_node( found_link );
+	}
+	else
+	{
+		_journal_node( node );
+		if ( tail_link != FREELIST_INVALID_NODE )
+		{
+			_node_at( tail_link )->next = node->next;
+			node->next = tail_link;
+			node->size = head_size;
+		}
+		else if ( head_size > 0 )
+		{
+			node->size = head_size;
+		}
+		else
+		{
+			node->offset = found_candidate + size;
+			node->size = tail_size;
+		}
+	}
+
+	offset = found_candidate;
+	_on_reserved( size );
+	return FreelistError::None;
 }
 
-void Freelist::unreserve( uint32_t offset, uint32_t size )
+FreelistError Freelist::_insert_free_range( uint32_t offset, uint32_t size )
 {
-	//  Zero out memory
-	memset( pointer_to_memory( offset ), 0, size );
-
-	if ( _head == nullptr )
+	if ( _header->head == FREELIST_INVALID_NODE )
 	{
 		//  No head? It means the freelist is empty: directly assign it
-		_head = _new_node( offset, size );
-		return;
+		const int32_t link = _new_node( offset, size );
+		if ( link == FREELIST_INVALID_NODE ) return FreelistError::NodeTableExhausted;
+
+		_header->head = link;
+		_header->free_size += size;
+		_on_free_node_grown( _node_at( link ) );
+		return FreelistError::None;
 	}
 
 	bool is_node_setup = false;
 	FreelistNode* previous = nullptr;
-	FreelistNode* current = _head;
-	while( current )
+	int32_t current_link = _header->head;
+	while( current_link != FREELIST_INVALID_NODE )
 	{
+		FreelistNode* current = _node_at( current_link );
+
 		//  Do we still need to insert the node?
 		if ( !is_node_setup )
 		{
 			//  Is directly at his right? Combine them
 			if ( current->offset + current->size == offset )
 			{
+				_journal_node( current );
 				current->size += size;
+				_on_free_node_grown( current );
 				is_node_setup = true;
 			}
 			//  Is directly at his left? Combine them
 			else if ( offset + size == current->offset )
 			{
+				_journal_node( current );
 				current->size += size;
 				current->offset -= size;
+				_on_free_node_grown( current );
 				is_node_setup = true;
 			}
 			//  Is somewhere on the left?
 			else if ( current->offset > offset )
 			{
-				FreelistNode* node = _new_node( offset, size );
+				const int32_t link = _new_node( offset, size );
+				if ( link == FREELIST_INVALID_NODE ) return FreelistError::NodeTableExhausted;
+
 				if ( !previous )
 				{
-					_head = node;
+					_header->head = link;
 				}
 				else
 				{
-					previous->next = node;
+					_journal_node( previous );
+					previous->next = link;
 				}
-				node->next = current;
+				_node_at( link )->next = current_link;
+				_on_free_node_grown( _node_at( link ) );
 				is_node_setup = true;
 			}
 			//  Is further away on the right that no nodes actually covered?
-			else if ( current->next == nullptr )
+			else if ( current->next == FREELIST_INVALID_NODE )
 			{
-				FreelistNode* node = _new_node( offset, size );
-				current->next = node;
+				const int32_t link = _new_node( offset, size );
+				if ( link == FREELIST_INVALID_NODE ) return FreelistError::NodeTableExhausted;
+
+				_journal_node( current );
+				current->next = link;
+				_on_free_node_grown( _node_at( link ) );
 				is_node_setup = true;
 			}
 		}
-		//  Combine fragmented nodes
+		//  Combine fragmented nodes, only the inserted node and its next one can touch since
+		//  the rest of the list is already combined
 		else
 		{
 			if ( previous->offset + previous->size == current->offset )
 			{
+				_journal_node( previous );
 				previous->size += current->size;
 				previous->next = current->next;
+				_on_free_node_grown( previous );
 
-				current->offset = 0;
-				current->size = 0;
-				current->next = nullptr;
-
-				current = previous->next;
-				previous = previous;
-				continue;
+				_delete_node( current_link );
 			}
+			break;
 		}
 
 		previous = current;
-		current = current->next;
+		current_link = current->next;
 	}
+
+	_header->free_size += size;
+	return FreelistError::None;
 }
 
 void Freelist::clear()
 {
+	LockScope lock( *this );
+	PROBE_SCOPE( clear_probe );
+
+	if ( _header == nullptr ) return;
+
+	_discard_checkpoints();
+	_discard_deferred_ranges();
+
 	//  Zero out user data memory
 	memset( pointer_to_memory( 0 ), 0, _data_size );
 
 	//  Reset nodes
-	FreelistNode* node = _head;
-	while ( node )
+	int32_t link = _header->head;
+	while ( link != FREELIST_INVALID_NODE )
 	{
-		auto next = node->next;
+		const int32_t next = _node_at( link )->next;
+		_delete_node( link );
+		link = next;
+	}
 
-		node->size = 0;
-		node->offset = 0;
-		node->next = nullptr;
+	_header->head = _new_node( 0, _data_size );
+	_header->free_size = _data_size;
 
-		node = next;
-	}
+#if FREELIST_ENABLE_STATS
+	_header->stats.used_size = 0;
+	_header->stats.free_block_count = 1;
+	_header->stats.largest_free_size = _data_size;
+	_header->is_largest_free_size_dirty = 0;
+#endif
+}
+
+bool Freelist::grow( uint32_t extra_size )
+{
+	LockScope lock( *this );
 
-	if ( _head == nullptr )
+	if ( _memory == nullptr || _shared_lock != nullptr || extra_size == 0 ) return false;
+
+	//  The total size, and so the data size, would wrap around
+	if ( extra_size > UINT32_MAX - _total_size ) return false;
+
+	_discard_checkpoints();
+
+	//  Nodes are linked by indices, moving the memory block doesn't break them
+	void* memory = nullptr;
+	if ( _is_mapped )
 	{
-		_head = _new_node( 0, _data_size );
+		//  Mapped memory can't be resized, copy it into a dynamic allocation
+		memory = malloc( _total_size + extra_size );
+		if ( memory == nullptr ) return false;
+
+		memcpy( memory, _memory, _total_size );
+
+		//  Deferred un-reservations are offsets, they stay valid in the copy
+		std::vector<DeferredRange> deferred_ranges {};
+		deferred_ranges.swap( _deferred_ranges );
+		const uint32_t deferred_size = _deferred_size;
+
+		_release_memory();
+
+		_deferred_ranges.swap( deferred_ranges );
+		_deferred_size = deferred_size;
 	}
 	else
 	{
-		_head->size = _data_size;
+		memory = realloc( _memory, _total_size + extra_size );
+		if ( memory == nullptr ) return false;
 	}
+	_attach_memory( memory );
+
+	//  Zero out and append the new space, the data size only grows once the space is free
+	const uint32_t offset = _data_size;
+	memset( pointer_to_memory( offset ), 0, extra_size );
+	if ( _insert_free_range( offset, extra_size ) != FreelistError::None ) return false;
+
+	_header->data_size += extra_size;
+	_attach_memory( memory );
+	return true;
+}
+
+void Freelist::set_out_of_memory_handler( FreelistOutOfMemoryHandler handler, void* user_data )
+{
+	LockScope lock( *this );
+
+	_out_of_memory_handler = handler;
+	_out_of_memory_user_data = user_data;
 }
 
 void* Freelist::pointer_to_memory( uint32_t offset, bool add_internal_size ) const
@@ -228,51 +646,238 @@ void* Freelist::pointer_to_memory( uint32_t offset, bool add_internal_size ) con
 
 FreelistNode* Freelist::head() const
 {
-	return _head;
+	assert( !_flush_thread.joinable() && "Stop the flush thread before walking the nodes" );
+
+	if ( _header == nullptr || _header->head == FREELIST_INVALID_NODE ) return nullptr;
+	return _node_at( _header->head );
+}
+
+FreelistNode* Freelist::next( const FreelistNode* node ) const
+{
+	assert( !_flush_thread.joinable() && "Stop the flush thread before walking the nodes" );
+
+	if ( node->next == FREELIST_INVALID_NODE ) return nullptr;
+	return _node_at( node->next );
+}
+
+bool Freelist::is_valid() const
+{
+	return _memory != nullptr;
+}
+
+bool Freelist::is_shared() const
+{
+	return _shared_lock != nullptr;
+}
+
+int Freelist::get_node_count() const
+{
+	LockScope lock( *this );
+	return _node_count;
 }
 
 uint32_t Freelist::get_total_size() const
 {
+	LockScope lock( *this );
 	return _total_size;
 }
 
 uint32_t Freelist::get_data_size() const
 {
+	LockScope lock( *this );
 	return _data_size;
 }
 
 uint32_t Freelist::get_internal_size() const
 {
+	LockScope lock( *this );
 	return _internal_size;
 }
 
 uint32_t Freelist::get_free_size() const
 {
-	uint32_t bytes = 0;
+	LockScope lock( *this );
+	if ( _header == nullptr ) return 0;
+	return _header->free_size;
+}
+
+FreelistStats Freelist::get_stats() const
+{
+	LockScope lock( *this );
+	if ( _header == nullptr ) return FreelistStats {};
+
+#if FREELIST_ENABLE_STATS
+	FreelistStats& stats = _header->stats;
+	if ( _header->is_largest_free_size_dirty )
+	{
+		stats.largest_free_size = 0;
+
+		for ( int32_t link = _header->head; link != FREELIST_INVALID_NODE; link = _node_at( link )->next )
+		{
+			const FreelistNode* node = _node_at( link );
+			if ( node->size > stats.largest_free_size )
+			{
+				stats.largest_free_size = node->size;
+			}
+		}
+
+		_header->is_largest_free_size_dirty = 0;
+	}
+
+	FreelistStats snapshot = stats;
+	snapshot.free_size = _header->free_size;
+	snapshot.deferred_size = _deferred_size;
+	snapshot.deferred_count = (int)_deferred_ranges.size();
+	return snapshot;
+#else
+	FreelistStats stats {};
+	stats.free_size = _header->free_size;
+	stats.used_size = _data_size - _header->free_size;
+	stats.deferred_size = _deferred_size;
+	stats.deferred_count = (int)_deferred_ranges.size();
+
+	for ( int32_t link = _header->head; link != FREELIST_INVALID_NODE; link = _node_at( link )->next )
+	{
+		const FreelistNode* node = _node_at( link );
+		if ( node->size > stats.largest_free_size )
+		{
+			stats.largest_free_size = node->size;
+		}
+		stats.free_block_count++;
+	}
+
+	return stats;
+#endif
+}
+
+int32_t Freelist::_new_node( uint32_t offset, uint32_t size )
+{
+	PROBE_SCOPE( new_node_probe );
+
+	const int32_t link = _header->unused_node;
+	if ( link == FREELIST_INVALID_NODE ) return FREELIST_INVALID_NODE;
+
+	FreelistNode& node = *_node_at( link );
+	_journal_node( &node );
+	_header->unused_node = node.next;
+
+	node.offset = offset;
+	node.size = size;
+	node.next = FREELIST_INVALID_NODE;
+#if FREELIST_ENABLE_STATS
+	_header->stats.free_block_count++;
+#endif
+	return link;
+}
+
+void Freelist::_delete_node( int32_t link )
+{
+	FreelistNode& node = *_node_at( link );
+	_journal_node( &node );
+	node.offset = 0;
+	node.size = 0;
+	node.next = _header->unused_node;
+	_header->unused_node = link;
+
+#if FREELIST_ENABLE_STATS
+	_header->stats.free_block_count--;
+#endif
+}
+
+uint32_t Freelist::_compute_internal_size( int node_count )
+{
+	const uint32_t size = sizeof( FreelistHeader ) + sizeof( FreelistNode ) * node_count;
+	return ( size + FREELIST_DATA_ALIGNMENT - 1 ) / FREELIST_DATA_ALIGNMENT * FREELIST_DATA_ALIGNMENT;
+}
+
+void Freelist::_format_memory( void* memory, uint32_t data_size, int node_count )
+{
+	//  Zero out memory
+	memset( memory, 0, _compute_internal_size( node_count ) + data_size );
 
-	FreelistNode* node = _head;
-	while( node )
+	FreelistHeader* header = new ( memory ) FreelistHeader();
+	header->data_size = data_size;
+	header->node_count = node_count;
+	_attach_memory( memory );
+
+	//  Chain all nodes as unused
+	for ( int i = 0; i < node_count; i++ )
 	{
-		bytes += node->size;
-		node = node->next;
+		_nodes[i].next = i + 1 < node_count ? _node_link( i + 1 ) : FREELIST_INVALID_NODE;
 	}
+	_header->unused_node = node_count > 0 ? _node_link( 0 ) : FREELIST_INVALID_NODE;
+
+	_header->head = _new_node( 0, _data_size );
+	_header->free_size = _data_size;
 
-	return bytes;
+#if FREELIST_ENABLE_STATS
+	_header->stats.largest_free_size = _data_size;
+#endif
 }
 
-FreelistNode* Freelist::_new_node( uint32_t offset, uint32_t size )
+void Freelist::_attach_memory( void* memory )
 {
-	for ( int i = 0; i < _node_count; i++ )
+	_memory = memory;
+
+	_header = (FreelistHeader*)_memory;
+	_nodes = (FreelistNode*)( (char*)_memory + sizeof( FreelistHeader ) );
+
+	_data_size = _header->data_size;
+	_node_count = _header->node_count;
+	_internal_size = _compute_internal_size( _node_count );
+	_total_size = _internal_size + _data_size;
+}
+
+void Freelist::_release_memory()
+{
+	if ( _memory == nullptr ) return;
+
+	if ( _is_mapped )
 	{
-		auto node = &_nodes[i];
-		if ( node->size == 0 )
-		{
-			node->offset = offset;
-			node->size = size;
-			node->next = nullptr;
-			return node;
-		}
+#ifndef _WIN32
+		munmap( _mapping, (size_t)_mapping_size );
+#endif
+	}
+	else
+	{
+		free( _memory );
+	}
+
+	_memory = nullptr;
+	_header = nullptr;
+	_nodes = nullptr;
+	_is_mapped = false;
+	_mapping = nullptr;
+	_mapping_size = 0;
+	_shared_lock = nullptr;
+
+	_discard_checkpoints();
+	_discard_deferred_ranges();
+}
+
+void Freelist::_on_reserved( uint32_t size )
+{
+	_header->free_size -= size;
+
+#if FREELIST_ENABLE_STATS
+	FreelistStats& stats = _header->stats;
+	stats.used_size += size;
+	if ( stats.used_size > stats.peak_used_size )
+	{
+		stats.peak_used_size = stats.used_size;
 	}
+	stats.reserve_count++;
+#endif
+}
 
-	return nullptr;
+void Freelist::_on_free_node_grown( const FreelistNode* node )
+{
+#if FREELIST_ENABLE_STATS
+	if ( node->size > _header->stats.largest_free_size )
+	{
+		_header->stats.largest_free_size = node->size;
+	}
+#else
+	(void)node;
+#endif
 }
\ No newline at end of file
@@ -1,6 +1,44 @@
 #pragma once
 
+#include <condition_variable>
 #include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Compile-time switch for the freelist statistics, define it to 0 to remove them entirely
+ * from the reserve and unreserve paths.
+ */
+#ifndef FREELIST_ENABLE_STATS
+#define FREELIST_ENABLE_STATS 1
+#endif
+
+/*
+ * Amount of buckets of the request sizes histogram, one per power of two.
+ */
+const int FREELIST_SIZE_HISTOGRAM_BUCKETS = 32;
+
+/*
+ * Link of a node meaning there is no node.
+ */
+const int32_t FREELIST_INVALID_NODE = -1;
+
+/*
+ * Alignment of the user data memory relative to the start of the memory block, in bytes.
+ */
+const uint32_t FREELIST_DATA_ALIGNMENT = 16;
+
+/*
+ * Size of a cache line, in bytes, used to isolate reservations from each other.
+ */
+const uint32_t FREELIST_CACHE_LINE_SIZE = 64;
+
+/*
+ * Distance between two addresses sharing the same L1 cache set on common CPUs, in bytes.
+ * Coloured reservations are staggered by a cache line within this distance.
+ */
+const uint32_t FREELIST_CACHE_COLOUR_STRIDE = 4096;
 
 /*
  * A node representing an un-reserved memory block inside the freelist linked list.
@@ -17,9 +55,200 @@ struct FreelistNode
 	uint32_t size = 0;
 
 	/*
-	 * For linked list purposes, the next node.
+	 * For linked list purposes, the link to the next node or FREELIST_INVALID_NODE.
+	 * A link is the position of a node in bytes from the start of the nodes, it is used instead of
+	 * a pointer so the nodes stay valid wherever the memory is located, and instead of an index
+	 * so that following it costs no more than following a pointer.
+	 */
+	int32_t next = FREELIST_INVALID_NODE;
+};
+
+/*
+ * Reasons for a freelist operation to fail.
+ */
+enum class FreelistError
+{
+	None,
+	/*
+	 * The free space is smaller than the requested size
+	 */
+	OutOfSpace,
+	/*
+	 * The free space is large enough but no free block can hold the requested size
+	 */
+	TooFragmented,
+	/*
+	 * A new free block is needed but all nodes are already in use
+	 */
+	NodeTableExhausted,
+};
+
+/*
+ * Returns a static string describing the given error.
+ */
+const char* freelist_error_to_str( FreelistError error );
+
+/*
+ * Expected lifetime of a reservation, used to keep blocks of different lifetimes apart so
+ * that short-lived holes don't get trapped between long-lived blocks.
+ */
+enum class FreelistLifetime
+{
+	/*
+	 * Carved from the end of the first free block large enough
+	 */
+	Normal,
+	/*
+	 * Freed soon, carved from the end of the last free block large enough, at the top of the memory
+	 */
+	Transient,
+	/*
+	 * Kept for a long time, carved from the start of the first free block large enough, at the bottom of the memory
+	 */
+	LongLived,
+};
+
+const int FREELIST_LIFETIME_COUNT = 3;
+
+/*
+ * Returns a static string describing the given lifetime.
+ */
+const char* freelist_lifetime_to_str( FreelistLifetime lifetime );
+
+class Freelist;
+
+/*
+ * Called when a reservation fails, with the failure reason and the requested size.
+ * The handler may grow the freelist, compact or evict reservations, then returns whenever
+ * the reservation should be retried.
+ */
+typedef bool ( *FreelistOutOfMemoryHandler )( Freelist& freelist, FreelistError error, uint32_t size, void* user_data );
+
+/*
+ * Maximum amount of times a reservation is retried after the out-of-memory handler.
+ */
+const int FREELIST_MAX_OUT_OF_MEMORY_RETRIES = 4;
+
+/*
+ * A point in time a freelist can be rolled back to, returned by 'Freelist::checkpoint'.
+ */
+struct FreelistCheckpoint
+{
+	/*
+	 * Position in the stack of active checkpoints, -1 if invalid, and serial number used
+	 * to detect checkpoints already rolled back or committed
+	 */
+	int depth = -1;
+	uint32_t serial = 0;
+
+	/*
+	 * Header state at the time of the checkpoint
+	 */
+	int32_t head = FREELIST_INVALID_NODE;
+	int32_t unused_node = FREELIST_INVALID_NODE;
+	uint32_t free_size = 0;
+#if FREELIST_ENABLE_STATS
+	uint32_t used_size = 0;
+	uint32_t largest_free_size = 0;
+	int free_block_count = 0;
+	uint32_t is_largest_free_size_dirty = 0;
+#endif
+
+	bool is_valid() const { return depth >= 0; }
+};
+
+/*
+ * Statistics of the reservations of a single lifetime.
+ */
+struct FreelistLifetimeStats
+{
+	uint64_t reserve_count = 0;
+	/*
+	 * Total amount of bytes ever reserved
+	 */
+	uint64_t reserved_size = 0;
+	/*
+	 * Amount of reserve calls which failed, after the out-of-memory handler
+	 */
+	uint64_t failure_count = 0;
+};
+
+/*
+ * A snapshot of the freelist statistics.
+ */
+struct FreelistStats
+{
+	/*
+	 * Bytes currently reserved and the highest amount ever reserved at once
+	 */
+	uint32_t used_size = 0;
+	uint32_t peak_used_size = 0;
+	/*
+	 * Bytes currently un-reserved and the size of the largest un-reserved block
+	 */
+	uint32_t free_size = 0;
+	uint32_t largest_free_size = 0;
+	int free_block_count = 0;
+	/*
+	 * Bytes and amount of deferred un-reservations waiting for a flush, still counted as used
+	 */
+	uint32_t deferred_size = 0;
+	int deferred_count = 0;
+
+	uint64_t reserve_count = 0;
+	uint64_t unreserve_count = 0;
+	/*
+	 * Amount of reserve and unreserve calls which failed, after the out-of-memory handler
+	 */
+	uint64_t failure_count = 0;
+
+	/*
+	 * Amount of reserve requests per size, bucket 'i' counting sizes in [2^i; 2^(i+1)[
+	 */
+	uint64_t size_histogram[FREELIST_SIZE_HISTOGRAM_BUCKETS] {};
+	/*
+	 * Reservations per lifetime hint, indexed by FreelistLifetime
+	 */
+	FreelistLifetimeStats lifetime_stats[FREELIST_LIFETIME_COUNT] {};
+
+	/*
+	 * Returns the part of the free space which can't be used by a single reservation,
+	 * from 0 when all free space is contiguous to almost 1 when it is scattered in tiny blocks.
+	 */
+	float get_fragmentation() const
+	{
+		if ( free_size == 0 ) return 0.0f;
+		return 1.0f - (float)largest_free_size / free_size;
+	}
+};
+
+/*
+ * State of the freelist, stored at the start of its memory block and followed by the nodes.
+ * It only contains sizes, offsets and links so the whole memory block can be saved to a file
+ * and mapped back at any address.
+ */
+struct FreelistHeader
+{
+	uint32_t data_size = 0;
+	int32_t node_count = 0;
+	/*
+	 * Link to the first node of the free blocks list
+	 */
+	int32_t head = FREELIST_INVALID_NODE;
+	/*
+	 * Link to the first node of the unused nodes list, chained through their 'next' link
+	 */
+	int32_t unused_node = FREELIST_INVALID_NODE;
+	uint32_t free_size = 0;
+
+#if FREELIST_ENABLE_STATS
+	/*
+	 * The largest free size is only known to be exact when not dirty, that is when the
+	 * largest node was not shrinked since the last snapshot.
 	 */
-	FreelistNode* next = nullptr;
+	uint32_t is_largest_free_size_dirty = 0;
+	FreelistStats stats {};
+#endif
 };
 
 /*
@@ -32,34 +261,194 @@ class Freelist
 public:
 	/*
 	 * Operates a dynamic memory allocation to initialize the pre-allocated memory block
-	 * for further usage.
+	 * for further usage. Check 'is_valid' to know whenever the allocation succeeded.
 	 */
 	Freelist( uint32_t data_size );
+	/*
+	 * Same as above with the given amount of nodes, which bounds the amount of free blocks.
+	 */
+	Freelist( uint32_t data_size, int node_count );
+	/*
+	 * Constructs an empty freelist without any memory, meant to be loaded from a file.
+	 */
+	Freelist();
 	/*
 	 * Frees the dynamic memory allocation.
 	 */
 	~Freelist();
 
+	Freelist( const Freelist& ) = delete;
+	Freelist& operator=( const Freelist& ) = delete;
+
 	/*
-	 * Finds and reserves a memory block of the given size.
-	 * Returns whenever the reservation was successful.
-	 * If successful, it also sets the 'offset' variable to the reserved position.
+	 * Finds and reserves a memory block of the given size, placed according to its expected lifetime.
+	 * Returns FreelistError::None if the reservation was successful, or the failure reason.
+	 * On failure, deferred un-reservations are flushed and the out-of-memory handler, if any,
+	 * is called before retrying. If successful, it also sets the 'offset' variable to the reserved position.
+	 * Fails with FreelistError::OutOfSpace if the freelist has no memory, see 'is_valid'.
 	 */
-	bool reserve( uint32_t size, uint32_t& offset );
+	FreelistError reserve( uint32_t size, uint32_t& offset, FreelistLifetime lifetime = FreelistLifetime::Normal );
+	/*
+	 * Reserves a memory block of the given size whose address is 'phase' bytes past a multiple of 'alignment',
+	 * which must be a power of two. The space skipped to align it stays free, but may need a new node.
+	 * The address is only aligned for the current memory block, growing or loading the freelist may move it.
+	 */
+	FreelistError reserve_aligned( uint32_t size, uint32_t alignment, uint32_t& offset, uint32_t phase = 0 );
+	/*
+	 * Reserves whole cache lines for a block of the given size, so that threads writing to different
+	 * reservations never write to the same cache line. It must be un-reserved with 'get_isolated_size'.
+	 * Fails with FreelistError::OutOfSpace if the size can't be rounded up to whole cache lines.
+	 */
+	FreelistError reserve_isolated( uint32_t size, uint32_t& offset );
+	/*
+	 * Returns the size actually reserved by 'reserve_isolated' for the given size, which must not be
+	 * above UINT32_MAX - FREELIST_CACHE_LINE_SIZE + 1.
+	 */
+	static uint32_t get_isolated_size( uint32_t size );
+	/*
+	 * Staggers the addresses of reservations of at least 'min_size' bytes by a cache line each, over
+	 * FREELIST_CACHE_COLOUR_STRIDE, so that their starts don't compete for the same cache sets.
+	 * It falls back to the normal placement when no free block fits the next colour.
+	 * A size of 0 disables the colouring.
+	 */
+	void set_cache_colouring( uint32_t min_size );
 	/*
 	 * Un-reserves the memory block at given offset and size.
+	 * Fails with FreelistError::NodeTableExhausted if the block can't be merged with a free block
+	 * and no node is available, the block is then left reserved.
+	 * When un-reservations are deferred, the block is only queued until the next flush.
+	 * Fails with FreelistError::OutOfSpace if the freelist has no memory.
+	 */
+	FreelistError unreserve( uint32_t offset, uint32_t size );
+	/*
+	 * Defers un-reservations: 'unreserve' queues blocks in constant time and they are applied all at
+	 * once by 'flush', which happens automatically once 'capacity' blocks are queued.
+	 * A capacity of 0 flushes the queue and goes back to immediate un-reservations.
+	 */
+	void set_deferred_free( uint32_t capacity );
+	/*
+	 * Applies the deferred un-reservations in a single pass over the nodes list, after sorting them
+	 * by offset and merging adjacent blocks together. Fails with FreelistError::NodeTableExhausted
+	 * if no node is available for a block, which is then kept queued with the following ones.
+	 */
+	FreelistError flush();
+	/*
+	 * Starts a background thread flushing deferred un-reservations every 'interval_ms' milliseconds.
+	 * While it runs, all operations are protected by a lock, except 'pointer_to_memory', 'is_valid'
+	 * and 'is_shared' which read what the thread never changes, and walking the nodes through
+	 * 'head' and 'next' which needs the thread to be stopped.
 	 */
-	void unreserve( uint32_t offset, uint32_t size );
+	void start_flush_thread( int interval_ms );
+	void stop_flush_thread();
 	/*
 	 * Clears the freelist of all allocations and reset its nodes.
+	 * All checkpoints become invalid.
 	 */
 	void clear();
+	/*
+	 * Grows the user data memory by the given size, the amount of nodes stays the same.
+	 * The memory block may move, invalidating all pointers previously returned by 'pointer_to_memory',
+	 * offsets stay valid. All checkpoints become invalid. Returns whenever the freelist has grown,
+	 * which fails if the total size would go above UINT32_MAX.
+	 */
+	bool grow( uint32_t extra_size );
+
+	/*
+	 * Starts recording the changes made to the nodes into an undo journal, so that they can be
+	 * undone by 'rollback' in a time proportional to their amount. Checkpoints can be nested.
+	 * Deferred un-reservations are flushed first, rolling back drops the ones queued since then.
+	 * Returns an invalid checkpoint for shared freelists, since other processes changes can't be undone.
+	 */
+	FreelistCheckpoint checkpoint();
+	/*
+	 * Restores the nodes as they were at the given checkpoint, un-reserving everything reserved
+	 * and reserving back everything un-reserved since then. Rolled back reservations are not zeroed
+	 * out and the content of un-reservations is not restored. The checkpoint and the ones nested
+	 * inside it become invalid. Returns whenever the checkpoint was valid.
+	 */
+	bool rollback( const FreelistCheckpoint& checkpoint );
+	/*
+	 * Keeps the changes made since the given checkpoint, which becomes invalid along with the ones
+	 * nested inside it. The journal is dropped once no checkpoint is left.
+	 * Returns whenever the checkpoint was valid.
+	 */
+	bool commit( const FreelistCheckpoint& checkpoint );
+
+	/*
+	 * Writes the whole memory block, nodes and user data, to the file at given path along with
+	 * a version and a checksum. Deferred un-reservations are not written, flush them first.
+	 * The file is written to 'path' followed by ".tmp" then renamed, so saving over the loaded file is safe.
+	 * Returns whenever the file was successfully written.
+	 */
+	bool save( const char* path ) const;
+	/*
+	 * Replaces the freelist by the one saved in the file at given path. When possible, the file
+	 * is mapped in memory instead of being read, modifications are then private to this process
+	 * and not written back. Verifying the checksum requires reading the whole file.
+	 * Returns whenever the file was successfully loaded, the freelist is left untouched otherwise.
+	 * Fails on a shared freelist, which other processes still use.
+	 */
+	bool load( const char* path, bool should_verify_checksum = true );
+
+	/*
+	 * Replaces the freelist by a new one placed inside a named shared memory segment, which other
+	 * processes can open with 'open_shared'. Reservations made by any process can be un-reserved
+	 * by any other. Fails if the segment already exists or on platforms without POSIX shared memory.
+	 */
+	bool create_shared( const char* name, uint32_t data_size );
+	/*
+	 * Replaces the freelist by the one inside the named shared memory segment.
+	 * Waits for the segment to be initialized by its creator.
+	 */
+	bool open_shared( const char* name );
+	/*
+	 * Removes the named shared memory segment, processes having it opened can keep using it.
+	 */
+	static bool unlink_shared( const char* name );
+
+	/*
+	 * Sets the handler called when a reservation fails, or nullptr to remove it.
+	 */
+	void set_out_of_memory_handler( FreelistOutOfMemoryHandler handler, void* user_data = nullptr );
 
 	/*
 	 * Returns the head of the nodes list or nullptr if there is no head.
 	 * If so, it's likely there is no free space available.
+	 * Not locked, the flush thread must be stopped while walking the nodes.
 	 */
 	FreelistNode* head() const;
+	/*
+	 * Returns the node following the given one in the nodes list or nullptr if it is the last one.
+	 */
+	FreelistNode* next( const FreelistNode* node ) const;
+	/*
+	 * Calls 'callback( uint32_t offset, uint32_t size )' for each reserved range in address order,
+	 * found between the free blocks. Adjacent reservations are visited as a single range, and
+	 * deferred un-reservations are still visited until flushed. The callback runs under the lock
+	 * and must not reserve or un-reserve.
+	 */
+	template <typename Callback>
+	void visit_reserved( Callback callback ) const
+	{
+		LockScope lock( *this );
+		if ( _header == nullptr ) return;
+
+		uint32_t offset = 0;
+		for ( int32_t link = _header->head; link != FREELIST_INVALID_NODE; link = _node_at( link )->next )
+		{
+			const FreelistNode* node = _node_at( link );
+			if ( node->offset > offset )
+			{
+				callback( offset, node->offset - offset );
+			}
+			offset = node->offset + node->size;
+		}
+
+		if ( offset < _data_size )
+		{
+			callback( offset, _data_size - offset );
+		}
+	}
 
 	/*
 	 * Returns a pointer to the memory given the offset.
@@ -68,6 +457,21 @@ public:
 	 */
 	void* pointer_to_memory( uint32_t offset, bool add_internal_size = true ) const;
 
+	/*
+	 * Returns whenever the memory block was successfully allocated.
+	 */
+	bool is_valid() const;
+	/*
+	 * Returns whenever the freelist is placed inside a shared memory segment.
+	 * If so, reserve, unreserve, clear and statistics are protected by a process-shared lock, but
+	 * iterating on the nodes is not.
+	 */
+	bool is_shared() const;
+	/*
+	 * Returns the maximum amount of nodes.
+	 */
+	int get_node_count() const;
+
 	/*
 	 * Returns the total size the freelist has allocated, in bytes.
 	 * The total size is the sum of the internal size plus the user data size.
@@ -78,19 +482,160 @@ public:
 	 */
 	uint32_t get_data_size() const;
 	/*
-	 * Returns the internal size used to contain the nodes, in bytes.
+	 * Returns the internal size used to contain the header and the nodes, in bytes.
 	 */
 	uint32_t get_internal_size() const;
 	/*
 	 * Returns the free space size, in bytes.
 	 */
 	uint32_t get_free_size() const;
+	/*
+	 * Returns a snapshot of the statistics.
+	 * When statistics are compiled out, only the sizes and free blocks are filled, by walking the nodes.
+	 */
+	FreelistStats get_stats() const;
 
 private:
 	/*
-	 * Finds and returns the first avaialble node and set it up with the given offset and size.
+	 * Finds a block large enough and carves the reservation from it, as described by the lifetime.
+	 */
+	FreelistError _reserve( uint32_t size, uint32_t& offset, FreelistLifetime lifetime );
+	/*
+	 * Finds a block large enough to hold the reservation at the given alignment and phase, carves it
+	 * at such an address as described by the lifetime and keeps the space left on both sides free.
+	 */
+	FreelistError _reserve_aligned( uint32_t size, uint32_t alignment, uint32_t phase, FreelistLifetime lifetime, uint32_t& offset );
+
+	/*
+	 * Where a reservation should be placed, an alignment of 1 meaning anywhere
 	 */
-	FreelistNode* _new_node( uint32_t offset = 0, uint32_t size = 0 );
+	struct Placement
+	{
+		FreelistLifetime lifetime = FreelistLifetime::Normal;
+		uint32_t alignment = 1;
+		uint32_t phase = 0;
+		/*
+		 * Whenever to fall back to any position if no block fits the alignment
+		 */
+		bool is_alignment_optional = false;
+	};
+
+	/*
+	 * Reserves the block as placed, flushing the deferred un-reservations and calling the out-of-memory
+	 * handler on failure, and updates the statistics.
+	 */
+	FreelistError _reserve_placed( uint32_t size, uint32_t& offset, const Placement& placement );
+	/*
+	 * Inserts the given range into the nodes list, merging it with its neighbours.
+	 * Neither zeroes out memory nor updates the reservation counters.
+	 */
+	FreelistError _insert_free_range( uint32_t offset, uint32_t size );
+
+	/*
+	 * Takes the first unused node and set it up with the given offset and size.
+	 * Returns its link or FREELIST_INVALID_NODE if all nodes are in use.
+	 */
+	int32_t _new_node( uint32_t offset = 0, uint32_t size = 0 );
+	/*
+	 * Invalidates the given node and puts it back in the unused nodes list.
+	 */
+	void _delete_node( int32_t link );
+
+	/*
+	 * Returns the node of the given link, which must be valid.
+	 */
+	FreelistNode* _node_at( int32_t link ) const
+	{
+		return (FreelistNode*)( (char*)_nodes + (uint32_t)link );
+	}
+	/*
+	 * Returns the link of the node at given index.
+	 */
+	static int32_t _node_link( int index )
+	{
+		return (int32_t)( index * sizeof( FreelistNode ) );
+	}
+
+	/*
+	 * Records the node in the undo journal before it gets modified, when a checkpoint is active.
+	 */
+	void _journal_node( const FreelistNode* node )
+	{
+		if ( _checkpoints.empty() ) return;
+
+		_journal.push_back( JournalEntry { (int32_t)( (const char*)node - (const char*)_nodes ), *node } );
+	}
+	/*
+	 * Returns whenever the checkpoint is one of the active checkpoints.
+	 */
+	bool _is_checkpoint_active( const FreelistCheckpoint& checkpoint ) const;
+	/*
+	 * Forgets about all checkpoints and the undo journal.
+	 */
+	void _discard_checkpoints();
+	/*
+	 * Forgets about the deferred un-reservations, leaving their blocks reserved.
+	 */
+	void _discard_deferred_ranges();
+
+	/*
+	 * Returns the size of the header and nodes for the given amount of nodes, in bytes.
+	 */
+	static uint32_t _compute_internal_size( int node_count );
+	/*
+	 * Initializes the header and the nodes of the given memory block and uses it as the freelist memory.
+	 */
+	void _format_memory( void* memory, uint32_t data_size, int node_count );
+	/*
+	 * Uses the given memory block, already containing a valid header, as the freelist memory.
+	 * The caller is responsible for setting how the memory has to be released.
+	 */
+	void _attach_memory( void* memory );
+	/*
+	 * Frees or unmaps the memory block.
+	 */
+	void _release_memory();
+
+	/*
+	 * Locks and unlocks the process-shared lock, only call them when the freelist is shared.
+	 */
+	void _lock() const;
+	void _unlock() const;
+
+	/*
+	 * Holds the process-shared lock for its lifetime when the freelist is shared, and the
+	 * thread lock when the flush thread runs.
+	 */
+	class LockScope
+	{
+	public:
+		LockScope( const Freelist& freelist )
+			: _freelist( freelist )
+		{
+			if ( _freelist._is_thread_locked ) _freelist._thread_lock.lock();
+			if ( _freelist._shared_lock ) _freelist._lock();
+		}
+		~LockScope()
+		{
+			if ( _freelist._shared_lock ) _freelist._unlock();
+			if ( _freelist._is_thread_locked ) _freelist._thread_lock.unlock();
+		}
+
+		LockScope( const LockScope& ) = delete;
+		LockScope& operator=( const LockScope& ) = delete;
+
+	private:
+		const Freelist& _freelist;
+	};
+
+	/*
+	 * Updates the counters after a successful reservation of the given size.
+	 */
+	void _on_reserved( uint32_t size );
+	/*
+	 * Updates the largest free size after the given node was created or merged.
+	 */
+	void _on_free_node_grown( const FreelistNode* node );
 
 private:
 	uint32_t _data_size = 0;
@@ -98,8 +643,72 @@ private:
 	uint32_t _internal_size = 0;
 	int _node_count = 0;
 
-	FreelistNode* _head = nullptr;
+	FreelistHeader* _header = nullptr;
 	FreelistNode* _nodes = nullptr;
 	
 	void* _memory = nullptr;
+	bool _is_mapped = false;
+	void* _mapping = nullptr;
+	uint64_t _mapping_size = 0;
+	/*
+	 * Mutex living inside the shared memory segment, nullptr when not shared
+	 */
+	void* _shared_lock = nullptr;
+
+	FreelistOutOfMemoryHandler _out_of_memory_handler = nullptr;
+	void* _out_of_memory_user_data = nullptr;
+
+	/*
+	 * Minimum size of the coloured reservations, 0 if disabled, and the colour of the next one carved
+	 * downward from the top of a block, or upward from its bottom for long-lived reservations
+	 */
+	uint32_t _cache_colouring_min_size = 0;
+	uint32_t _next_top_down_cache_colour = 0;
+	uint32_t _next_bottom_up_cache_colour = 0;
+
+	/*
+	 * A node as it was before being modified
+	 */
+	struct JournalEntry
+	{
+		int32_t link;
+		FreelistNode node;
+	};
+	/*
+	 * An active checkpoint and the size of the journal when it was made
+	 */
+	struct ActiveCheckpoint
+	{
+		uint32_t serial;
+		uint32_t journal_size;
+	};
+
+	std::vector<JournalEntry> _journal {};
+	std::vector<ActiveCheckpoint> _checkpoints {};
+	uint32_t _checkpoint_serial = 0;
+
+	/*
+	 * A block waiting to be un-reserved
+	 */
+	struct DeferredRange
+	{
+		uint32_t offset;
+		uint32_t size;
+	};
+
+	/*
+	 * Deferred un-reservations, pre-allocated to the capacity
+	 */
+	std::vector<DeferredRange> _deferred_ranges {};
+	uint32_t _deferred_capacity = 0;
+	uint32_t _deferred_size = 0;
+
+	std::thread _flush_thread {};
+	std::condition_variable_any _flush_thread_condition {};
+	bool _should_stop_flush_thread = false;
+	/*
+	 * Recursive since operations can call each others, e.g. through the out-of-memory handler
+	 */
+	mutable std::recursive_mutex _thread_lock {};
+	bool _is_thread_locked = false;
 };
\ No newline at end of file
@@ -0,0 +1,186 @@
+#include "freelist.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "probe.h"
+
+#if ENABLE_PROBES
+static Probe flush_probe( "Freelist::flush" );
+#endif
+
+void Freelist::set_deferred_free( uint32_t capacity )
+{
+	LockScope lock( *this );
+
+	//  Queued blocks must not wait past the new capacity
+	if ( _deferred_ranges.size() >= std::max( capacity, 1u ) )
+	{
+		flush();
+	}
+
+	_deferred_capacity = capacity;
+	_deferred_ranges.reserve( capacity );
+}
+
+FreelistError Freelist::flush()
+{
+	LockScope lock( *this );
+	PROBE_SCOPE( flush_probe );
+
+	if ( _memory == nullptr || _deferred_ranges.empty() ) return FreelistError::None;
+
+	//  Sort by offset and merge the adjacent blocks together
+	std::sort( _deferred_ranges.begin(), _deferred_ranges.end(),
+		[]( const DeferredRange& a, const DeferredRange& b ) { return a.offset < b.offset; } );
+
+	uint32_t range_count = 0;
+	for ( const DeferredRange& range : _deferred_ranges )
+	{
+		if ( range_count > 0 )
+		{
+			DeferredRange& last = _deferred_ranges[range_count - 1];
+			if ( last.offset + last.size == range.offset )
+			{
+				last.size += range.size;
+				continue;
+			}
+		}
+
+		_deferred_ranges[range_count++] = range;
+	}
+	_deferred_ranges.resize( range_count );
+
+	//  Insert them in a single pass, both lists being ordered
+	FreelistError error = FreelistError::None;
+	uint32_t flushed_count = 0;
+	uint32_t flushed_size = 0;
+	FreelistNode* previous = nullptr;
+	int32_t current_link = _header->head;
+	for ( ; flushed_count < range_count; flushed_count++ )
+	{
+		const DeferredRange& range = _deferred_ranges[flushed_count];
+
+		//  Skip the nodes ending before the block
+		FreelistNode* current = nullptr;
+		while ( current_link != FREELIST_INVALID_NODE )
+		{
+			current = _node_at( current_link );
+			if ( current->offset + current->size >= range.offset ) break;
+
+			previous = current;
+			current_link = current->next;
+			current = nullptr;
+		}
+
+		//  Is directly at its right? Combine them, and with the next node if it now touches it
+		if ( current && current->offset + current->size == range.offset )
+		{
+			_journal_node( current );
+			current->size += range.size;
+
+			const int32_t next_link = current->next;
+			if ( next_link != FREELIST_INVALID_NODE )
+			{
+				const FreelistNode* next = _node_at( next_link );
+				if ( current->offset + current->size == next->offset )
+				{
+					current->size += next->size;
+					current->next = next->next;
+					_delete_node( next_link );
+				}
+			}
+			_on_free_node_grown( current );
+		}
+		//  Is directly at its left? Combine them
+		else if ( current && range.offset + range.size == current->offset )
+		{
+			_journal_node( current );
+			current->offset -= range.size;
+			current->size += range.size;
+			_on_free_node_grown( current );
+		}
+		//  Is between the previous and the current node, or after the last one
+		else
+		{
+			const int32_t link = _new_node( range.offset, range.size );
+			if ( link == FREELIST_INVALID_NODE )
+			{
+				error = FreelistError::NodeTableExhausted;
+				break;
+			}
+
+			FreelistNode* node = _node_at( link );
+			node->next = current_link;
+			if ( previous )
+			{
+				_journal_node( previous );
+				previous->next = link;
+			}
+			else
+			{
+				_header->head = link;
+			}
+			_on_free_node_grown( node );
+			previous = node;
+		}
+
+		//  Zero out memory
+		memset( pointer_to_memory( range.offset ), 0, range.size );
+		flushed_size += range.size;
+	}
+
+	//  Keep the blocks which couldn't be inserted for a later flush
+	_deferred_ranges.erase( _deferred_ranges.begin(), _deferred_ranges.begin() + flushed_count );
+	_deferred_size -= flushed_size;
+	_header->free_size += flushed_size;
+
+#if FREELIST_ENABLE_STATS
+	_header->stats.used_size -= flushed_size;
+	if ( error != FreelistError::None )
+	{
+		_header->stats.failure_count++;
+	}
+#endif
+	return error;
+}
+
+void Freelist::start_flush_thread( int interval_ms )
+{
+	stop_flush_thread();
+
+	_should_stop_flush_thread = false;
+	_is_thread_locked = true;
+	_flush_thread = std::thread( [this, interval_ms]()
+	{
+		std::unique_lock<std::recursive_mutex> lock( _thread_lock );
+		while ( !_should_stop_flush_thread )
+		{
+			_flush_thread_condition.wait_for( lock, std::chrono::milliseconds( interval_ms ) );
+			if ( _should_stop_flush_thread ) break;
+
+			flush();
+		}
+	} );
+}
+
+void Freelist::stop_flush_thread()
+{
+	if ( !_flush_thread.joinable() ) return;
+
+	{
+		std::lock_guard<std::recursive_mutex> lock( _thread_lock );
+		_should_stop_flush_thread = true;
+	}
+	_flush_thread_condition.notify_all();
+	_flush_thread.join();
+
+	_is_thread_locked = false;
+}
+
+void Freelist::_discard_deferred_ranges()
+{
+	_deferred_ranges.clear();
+	_deferred_size = 0;
+}
@@ -0,0 +1,90 @@
+#include "freelist.h"
+
+FreelistCheckpoint Freelist::checkpoint()
+{
+	LockScope lock( *this );
+
+	FreelistCheckpoint checkpoint {};
+	if ( _memory == nullptr || _shared_lock != nullptr ) return checkpoint;
+
+	//  Queued blocks would be dropped by a rollback
+	if ( flush() != FreelistError::None ) return checkpoint;
+
+	checkpoint.depth = (int)_checkpoints.size();
+	checkpoint.serial = ++_checkpoint_serial;
+	checkpoint.head = _header->head;
+	checkpoint.unused_node = _header->unused_node;
+	checkpoint.free_size = _header->free_size;
+#if FREELIST_ENABLE_STATS
+	checkpoint.used_size = _header->stats.used_size;
+	checkpoint.largest_free_size = _header->stats.largest_free_size;
+	checkpoint.free_block_count = _header->stats.free_block_count;
+	checkpoint.is_largest_free_size_dirty = _header->is_largest_free_size_dirty;
+#endif
+
+	_checkpoints.push_back( ActiveCheckpoint { checkpoint.serial, (uint32_t)_journal.size() } );
+	return checkpoint;
+}
+
+bool Freelist::rollback( const FreelistCheckpoint& checkpoint )
+{
+	LockScope lock( *this );
+
+	if ( !_is_checkpoint_active( checkpoint ) ) return false;
+
+	//  Undo the node changes, latest first
+	const uint32_t journal_size = _checkpoints[checkpoint.depth].journal_size;
+	for ( uint32_t i = (uint32_t)_journal.size(); i > journal_size; i-- )
+	{
+		const JournalEntry& entry = _journal[i - 1];
+		*_node_at( entry.link ) = entry.node;
+	}
+	_journal.resize( journal_size );
+	_discard_deferred_ranges();
+
+	_header->head = checkpoint.head;
+	_header->unused_node = checkpoint.unused_node;
+	_header->free_size = checkpoint.free_size;
+#if FREELIST_ENABLE_STATS
+	//  Operation counters keep what happened
+	_header->stats.used_size = checkpoint.used_size;
+	_header->stats.largest_free_size = checkpoint.largest_free_size;
+	_header->stats.free_block_count = checkpoint.free_block_count;
+	_header->is_largest_free_size_dirty = checkpoint.is_largest_free_size_dirty;
+#endif
+
+	_checkpoints.resize( checkpoint.depth );
+	if ( _checkpoints.empty() )
+	{
+		_journal.clear();
+	}
+	return true;
+}
+
+bool Freelist::commit( const FreelistCheckpoint& checkpoint )
+{
+	LockScope lock( *this );
+
+	if ( !_is_checkpoint_active( checkpoint ) ) return false;
+
+	//  Outer checkpoints may still need the journal
+	_checkpoints.resize( checkpoint.depth );
+	if ( _checkpoints.empty() )
+	{
+		_journal.clear();
+	}
+	return true;
+}
+
+bool Freelist::_is_checkpoint_active( const FreelistCheckpoint& checkpoint ) const
+{
+	return checkpoint.is_valid()
+		&& checkpoint.depth < (int)_checkpoints.size()
+		&& _checkpoints[checkpoint.depth].serial == checkpoint.serial;
+}
+
+void Freelist::_discard_checkpoints()
+{
+	_checkpoints.clear();
+	_journal.clear();
+}
@@ -0,0 +1,215 @@
+#include "freelist.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <stdio.h>
+#include <string>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const char FILE_MAGIC[8] = { 'F', 'R', 'E', 'E', 'L', 'I', 'S', 'T' };
+	/*
+	 * Increase it whenever the header, the nodes or the file layout change.
+	 */
+	const uint32_t FILE_VERSION = 3;
+
+	/*
+	 * Written before the freelist memory block.
+	 */
+	struct FileHeader
+	{
+		char magic[8];
+		uint32_t version;
+		/*
+		 * Size of the freelist header, which depends on whenever statistics are compiled in
+		 */
+		uint32_t header_size;
+		uint64_t memory_size;
+		uint64_t checksum;
+	};
+
+	/*
+	 * FNV-1a applied on 64-bits words rather than bytes, to hash large memory blocks quickly.
+	 */
+	uint64_t compute_checksum( const void* memory, uint64_t size )
+	{
+		const uint64_t PRIME = 1099511628211ull;
+		uint64_t hash = 14695981039346656037ull;
+
+		const unsigned char* bytes = (const unsigned char*)memory;
+		const uint64_t word_count = size / sizeof( uint64_t );
+		for ( uint64_t i = 0; i < word_count; i++ )
+		{
+			uint64_t word;
+			memcpy( &word, bytes + i * sizeof( uint64_t ), sizeof( uint64_t ) );
+			hash = ( hash ^ word ) * PRIME;
+		}
+		for ( uint64_t i = word_count * sizeof( uint64_t ); i < size; i++ )
+		{
+			hash = ( hash ^ bytes[i] ) * PRIME;
+		}
+
+		return hash;
+	}
+
+	FILE* open_file( const char* path, const char* mode )
+	{
+#ifdef _MSC_VER
+		FILE* file = nullptr;
+		if ( fopen_s( &file, path, mode ) != 0 ) return nullptr;
+		return file;
+#else
+		return fopen( path, mode );
+#endif
+	}
+
+	bool is_valid_link( int32_t link, int32_t node_count )
+	{
+		if ( link == FREELIST_INVALID_NODE ) return true;
+		if ( link < 0 || link % sizeof( FreelistNode ) != 0 ) return false;
+		return link / sizeof( FreelistNode ) < (uint32_t)node_count;
+	}
+
+	/*
+	 * Checks the file header and the freelist header against the memory size.
+	 */
+	bool is_valid_snapshot( const FileHeader& file_header, const void* memory, uint64_t memory_size )
+	{
+		if ( memcmp( file_header.magic, FILE_MAGIC, sizeof( FILE_MAGIC ) ) != 0 ) return false;
+		if ( file_header.version != FILE_VERSION ) return false;
+		if ( file_header.header_size != sizeof( FreelistHeader ) ) return false;
+		if ( file_header.memory_size != memory_size ) return false;
+		if ( memory_size < sizeof( FreelistHeader ) ) return false;
+
+		const FreelistHeader* header = (const FreelistHeader*)memory;
+		if ( header->node_count < 0 ) return false;
+		if ( !is_valid_link( header->head, header->node_count ) ) return false;
+		if ( !is_valid_link( header->unused_node, header->node_count ) ) return false;
+
+		const uint64_t nodes_size = sizeof( FreelistHeader ) + sizeof( FreelistNode ) * (uint64_t)header->node_count;
+		const uint64_t internal_size = ( nodes_size + FREELIST_DATA_ALIGNMENT - 1 ) / FREELIST_DATA_ALIGNMENT * FREELIST_DATA_ALIGNMENT;
+		return internal_size + header->data_size == memory_size;
+	}
+}
+
+bool Freelist::save( const char* path ) const
+{
+	if ( _memory == nullptr ) return false;
+
+	LockScope lock( *this );
+
+	FileHeader file_header {};
+	memcpy( file_header.magic, FILE_MAGIC, sizeof( FILE_MAGIC ) );
+	file_header.version = FILE_VERSION;
+	file_header.header_size = sizeof( FreelistHeader );
+	file_header.memory_size = _total_size;
+	file_header.checksum = compute_checksum( _memory, _total_size );
+
+	//  Write next to the file then swap it in: the file may be mapped by a previous 'load',
+	//  truncating it would pull the pages from under us, and a crash keeps the previous snapshot
+	const std::string temporary_path = std::string( path ) + ".tmp";
+	FILE* file = open_file( temporary_path.c_str(), "wb" );
+	if ( file == nullptr ) return false;
+
+	bool is_written = fwrite( &file_header, sizeof( FileHeader ), 1, file ) == 1
+		&& fwrite( _memory, _total_size, 1, file ) == 1;
+	is_written = fclose( file ) == 0 && is_written;
+	if ( !is_written )
+	{
+		remove( temporary_path.c_str() );
+		return false;
+	}
+
+#ifdef _WIN32
+	//  Renaming doesn't replace an existing file there, loaded files aren't mapped either
+	remove( path );
+#endif
+	return rename( temporary_path.c_str(), path ) == 0;
+}
+
+bool Freelist::load( const char* path, bool should_verify_checksum )
+{
+	//  Releasing the segment would drop its lock while the scope still holds it
+	if ( _shared_lock != nullptr ) return false;
+
+	LockScope lock( *this );
+
+#ifndef _WIN32
+	//  Map the whole file, the memory block directly follows the file header
+	const int descriptor = open( path, O_RDONLY );
+	if ( descriptor == -1 ) return false;
+
+	struct stat file_stat {};
+	if ( fstat( descriptor, &file_stat ) != 0 || (uint64_t)file_stat.st_size < sizeof( FileHeader ) )
+	{
+		close( descriptor );
+		return false;
+	}
+
+	const uint64_t mapping_size = (uint64_t)file_stat.st_size;
+	void* mapping = mmap( nullptr, (size_t)mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, descriptor, 0 );
+	close( descriptor );
+	if ( mapping == MAP_FAILED ) return false;
+
+	const FileHeader& file_header = *(const FileHeader*)mapping;
+	void* memory = (char*)mapping + sizeof( FileHeader );
+	const uint64_t memory_size = mapping_size - sizeof( FileHeader );
+
+	const bool is_valid = is_valid_snapshot( file_header, memory, memory_size )
+		&& ( !should_verify_checksum || compute_checksum( memory, memory_size ) == file_header.checksum );
+	if ( !is_valid )
+	{
+		munmap( mapping, (size_t)mapping_size );
+		return false;
+	}
+
+	_release_memory();
+	_attach_memory( memory );
+	_is_mapped = true;
+	_mapping = mapping;
+	_mapping_size = mapping_size;
+	return true;
+#else
+	//  No mapping, read the memory block into a dynamic allocation
+	FILE* file = open_file( path, "rb" );
+	if ( file == nullptr ) return false;
+
+	FileHeader file_header {};
+	if ( fread( &file_header, sizeof( FileHeader ), 1, file ) != 1
+	  || file_header.memory_size < sizeof( FreelistHeader ) )
+	{
+		fclose( file );
+		return false;
+	}
+
+	void* memory = malloc( (size_t)file_header.memory_size );
+	if ( memory == nullptr )
+	{
+		fclose( file );
+		return false;
+	}
+
+	const bool is_read = fread( memory, (size_t)file_header.memory_size, 1, file ) == 1;
+	fclose( file );
+
+	const bool is_valid = is_read
+		&& is_valid_snapshot( file_header, memory, file_header.memory_size )
+		&& ( !should_verify_checksum || compute_checksum( memory, file_header.memory_size ) == file_header.checksum );
+	if ( !is_valid )
+	{
+		free( memory );
+		return false;
+	}
+
+	_release_memory();
+	_attach_memory( memory );
+	return true;
+#endif
+}
\ No newline at end of file
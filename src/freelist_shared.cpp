@@ -0,0 +1,196 @@
+#include "freelist.h"
+
+#ifndef _WIN32
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+	const char SEGMENT_MAGIC[8] = { 'F', 'R', 'E', 'E', 'S', 'H', 'M', '1' };
+
+	/*
+	 * Maximum amount of times 'open_shared' checks whenever the segment is initialized.
+	 */
+	const int OPEN_ATTEMPTS = 1000;
+
+	/*
+	 * Placed at the start of the shared memory segment, before the freelist memory block.
+	 */
+	struct SegmentHeader
+	{
+		char magic[8];
+		/*
+		 * Set by the creator once the lock and the freelist are initialized
+		 */
+		std::atomic<uint32_t> is_initialized;
+		uint64_t memory_size;
+		pthread_mutex_t mutex;
+	};
+
+	/*
+	 * The freelist memory block starts on its own cache line, after the segment header.
+	 */
+	const uint64_t SEGMENT_HEADER_SIZE = ( sizeof( SegmentHeader ) + 63 ) / 64 * 64;
+}
+
+bool Freelist::create_shared( const char* name, uint32_t data_size )
+{
+	const int node_count = data_size / ( sizeof( void* ) ) / 4;
+	const uint64_t memory_size = _compute_internal_size( node_count ) + (uint64_t)data_size;
+	const uint64_t mapping_size = SEGMENT_HEADER_SIZE + memory_size;
+
+	const int descriptor = shm_open( name, O_CREAT | O_EXCL | O_RDWR, 0600 );
+	if ( descriptor == -1 ) return false;
+
+	if ( ftruncate( descriptor, (off_t)mapping_size ) != 0 )
+	{
+		close( descriptor );
+		shm_unlink( name );
+		return false;
+	}
+
+	void* mapping = mmap( nullptr, (size_t)mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0 );
+	close( descriptor );
+	if ( mapping == MAP_FAILED )
+	{
+		shm_unlink( name );
+		return false;
+	}
+
+	//  Robust so that a process dying while holding the lock doesn't block all others,
+	//  recursive so that the out-of-memory handler can un-reserve while a reservation holds it
+	SegmentHeader* segment = new ( mapping ) SegmentHeader();
+	memcpy( segment->magic, SEGMENT_MAGIC, sizeof( SEGMENT_MAGIC ) );
+	segment->memory_size = memory_size;
+
+	pthread_mutexattr_t attributes;
+	pthread_mutexattr_init( &attributes );
+	pthread_mutexattr_setpshared( &attributes, PTHREAD_PROCESS_SHARED );
+	pthread_mutexattr_setrobust( &attributes, PTHREAD_MUTEX_ROBUST );
+	pthread_mutexattr_settype( &attributes, PTHREAD_MUTEX_RECURSIVE );
+	const int result = pthread_mutex_init( &segment->mutex, &attributes );
+	pthread_mutexattr_destroy( &attributes );
+	if ( result != 0 )
+	{
+		munmap( mapping, (size_t)mapping_size );
+		shm_unlink( name );
+		return false;
+	}
+
+	_release_memory();
+	_format_memory( (char*)mapping + SEGMENT_HEADER_SIZE, data_size, node_count );
+	_is_mapped = true;
+	_mapping = mapping;
+	_mapping_size = mapping_size;
+	_shared_lock = &segment->mutex;
+
+	segment->is_initialized.store( 1, std::memory_order_release );
+	return true;
+}
+
+bool Freelist::open_shared( const char* name )
+{
+	const int descriptor = shm_open( name, O_RDWR, 0600 );
+	if ( descriptor == -1 ) return false;
+
+	//  The creator may not have sized the segment yet
+	struct stat segment_stat {};
+	for ( int i = 0; i < OPEN_ATTEMPTS; i++ )
+	{
+		if ( fstat( descriptor, &segment_stat ) != 0 ) break;
+		if ( (uint64_t)segment_stat.st_size > SEGMENT_HEADER_SIZE ) break;
+
+		sched_yield();
+	}
+
+	const uint64_t mapping_size = (uint64_t)segment_stat.st_size;
+	if ( mapping_size <= SEGMENT_HEADER_SIZE )
+	{
+		close( descriptor );
+		return false;
+	}
+
+	void* mapping = mmap( nullptr, (size_t)mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0 );
+	close( descriptor );
+	if ( mapping == MAP_FAILED ) return false;
+
+	SegmentHeader* segment = (SegmentHeader*)mapping;
+	bool is_initialized = false;
+	for ( int i = 0; i < OPEN_ATTEMPTS && !is_initialized; i++ )
+	{
+		is_initialized = segment->is_initialized.load( std::memory_order_acquire ) == 1;
+		if ( !is_initialized )
+		{
+			sched_yield();
+		}
+	}
+
+	const bool is_valid = is_initialized
+		&& memcmp( segment->magic, SEGMENT_MAGIC, sizeof( SEGMENT_MAGIC ) ) == 0
+		&& SEGMENT_HEADER_SIZE + segment->memory_size == mapping_size;
+	if ( !is_valid )
+	{
+		munmap( mapping, (size_t)mapping_size );
+		return false;
+	}
+
+	_release_memory();
+	_attach_memory( (char*)mapping + SEGMENT_HEADER_SIZE );
+	_is_mapped = true;
+	_mapping = mapping;
+	_mapping_size = mapping_size;
+	_shared_lock = &segment->mutex;
+	return true;
+}
+
+bool Freelist::unlink_shared( const char* name )
+{
+	return shm_unlink( name ) == 0;
+}
+
+void Freelist::_lock() const
+{
+	pthread_mutex_t* mutex = (pthread_mutex_t*)_shared_lock;
+
+	//  The previous owner died while holding the lock, its last operation may be incomplete
+	//  but there is nothing better to do than to keep going
+	if ( pthread_mutex_lock( mutex ) == EOWNERDEAD )
+	{
+		pthread_mutex_consistent( mutex );
+	}
+}
+
+void Freelist::_unlock() const
+{
+	pthread_mutex_unlock( (pthread_mutex_t*)_shared_lock );
+}
+#else
+bool Freelist::create_shared( const char* name, uint32_t data_size )
+{
+	return false;
+}
+
+bool Freelist::open_shared( const char* name )
+{
+	return false;
+}
+
+bool Freelist::unlink_shared( const char* name )
+{
+	return false;
+}
+
+void Freelist::_lock() const
+{}
+
+void Freelist::_unlock() const
+{}
+#endif
\ No newline at end of file
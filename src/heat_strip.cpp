@@ -0,0 +1,96 @@
+#include "heat_strip.h"
+
+#include <algorithm>
+
+void HeatStrip::set_range( uint32_t offset, uint32_t size, int max_column_count )
+{
+	max_column_count = std::max( max_column_count, 1 );
+
+	const uint32_t column_size = std::max( ( size + max_column_count - 1 ) / max_column_count, 1u );
+	const int column_count = size > 0 ? (int)( ( size + column_size - 1 ) / column_size ) : 0;
+	if ( offset == _offset && size == _size && column_count == get_column_count() ) return;
+
+	_offset = offset;
+	_size = size;
+	_column_size = column_size;
+	_used_sizes.resize( column_count );
+	_is_dirty = true;
+}
+
+void HeatStrip::invalidate()
+{
+	_is_dirty = true;
+}
+
+void HeatStrip::update( const Freelist& freelist )
+{
+	if ( !_is_dirty ) return;
+	_is_dirty = false;
+
+	//  Everything is reserved, except what the free nodes cover
+	for ( int i = 0; i < get_column_count(); i++ )
+	{
+		_used_sizes[i] = _get_column_span( i );
+	}
+
+	const uint32_t end = _offset + _size;
+	const FreelistNode* node = freelist.head();
+	while ( node )
+	{
+		//  Nodes are sorted by offset
+		if ( node->offset >= end ) break;
+
+		_apply_range( node->offset, node->size, false );
+		node = freelist.next( node );
+	}
+}
+
+void HeatStrip::on_reserved( uint32_t offset, uint32_t size )
+{
+	if ( _is_dirty ) return;
+
+	_apply_range( offset, size, true );
+}
+
+void HeatStrip::on_unreserved( uint32_t offset, uint32_t size )
+{
+	if ( _is_dirty ) return;
+
+	_apply_range( offset, size, false );
+}
+
+float HeatStrip::get_used_ratio( int column ) const
+{
+	return (float)_used_sizes[column] / (float)_get_column_span( column );
+}
+
+void HeatStrip::_apply_range( uint32_t offset, uint32_t size, bool is_reserved )
+{
+	const uint64_t start = std::max( (uint64_t)offset, (uint64_t)_offset );
+	const uint64_t end = std::min( (uint64_t)offset + size, (uint64_t)_offset + _size );
+	if ( start >= end ) return;
+
+	const int first_column = (int)( ( start - _offset ) / _column_size );
+	const int last_column = (int)( ( end - 1 - _offset ) / _column_size );
+	for ( int i = first_column; i <= last_column; i++ )
+	{
+		const uint64_t column_start = (uint64_t)_offset + (uint64_t)i * _column_size;
+		const uint64_t column_end = column_start + _get_column_span( i );
+		const uint32_t overlap = (uint32_t)( std::min( end, column_end ) - std::max( start, column_start ) );
+
+		if ( is_reserved )
+		{
+			_used_sizes[i] += overlap;
+		}
+		else
+		{
+			_used_sizes[i] -= overlap;
+		}
+	}
+}
+
+uint32_t HeatStrip::_get_column_span( int column ) const
+{
+	const uint32_t column_start = (uint32_t)column * _column_size;
+	return std::min( _column_size, _size - column_start );
+}
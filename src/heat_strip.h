@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "freelist.h"
+
+/*
+ * Level-of-detail summary of a range of the freelist data, split into equally sized columns
+ * which each hold the amount of reserved bytes they cover.
+ * The columns are rebuilt from the freelist only when the range changes, reservations and
+ * un-reservations are then applied incrementally to the columns they touch.
+ */
+class HeatStrip
+{
+public:
+	/*
+	 * Sets the range of data covered by the strip, split into at most 'max_column_count' columns.
+	 * A column covers a whole amount of bytes, so less columns can be used for small ranges.
+	 * The strip is rebuilt on the next update if the layout changed.
+	 */
+	void set_range( uint32_t offset, uint32_t size, int max_column_count );
+	/*
+	 * Forces the strip to be rebuilt on the next update, needed once the freelist was changed
+	 * without notifying the strip (e.g. cleared or replaced).
+	 */
+	void invalidate();
+	/*
+	 * Rebuilds the columns by walking the free nodes of the freelist, if invalidated.
+	 */
+	void update( const Freelist& freelist );
+
+	/*
+	 * Accounts for a reservation or an un-reservation, only updating the columns it overlaps.
+	 */
+	void on_reserved( uint32_t offset, uint32_t size );
+	void on_unreserved( uint32_t offset, uint32_t size );
+
+	/*
+	 * Returns the ratio of reserved bytes covered by the column, from 0.0f to 1.0f.
+	 */
+	float get_used_ratio( int column ) const;
+	int get_column_count() const { return (int)_used_sizes.size(); }
+	/*
+	 * Returns the amount of bytes covered by each column, except the last one which may be smaller.
+	 */
+	uint32_t get_column_size() const { return _column_size; }
+
+private:
+	/*
+	 * Adds or subtracts the bytes of the given range to the columns it overlaps.
+	 */
+	void _apply_range( uint32_t offset, uint32_t size, bool is_reserved );
+	uint32_t _get_column_span( int column ) const;
+
+private:
+	uint32_t _offset = 0;
+	uint32_t _size = 0;
+	uint32_t _column_size = 1;
+
+	/*
+	 * Amount of reserved bytes per column
+	 */
+	std::vector<uint32_t> _used_sizes {};
+	bool _is_dirty = true;
+};
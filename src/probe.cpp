@@ -0,0 +1,232 @@
+#include "probe.h"
+
+#include <chrono>
+#include <cstring>
+#include <stdio.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#elif PROBES_USE_TSC
+#include <x86intrin.h>
+#endif
+
+using namespace std::chrono;
+
+//  Zero-initialized before any dynamic initialization, so probes can register from any translation unit
+static Probe* first_probe = nullptr;
+
+static int highest_bit( uint64_t value )
+{
+#ifdef _MSC_VER
+	unsigned long index = 0;
+#ifdef _M_X64
+	_BitScanReverse64( &index, value );
+#else
+	//  No 64-bits scan on 32-bits targets, scan the high then the low half
+	if ( _BitScanReverse( &index, (unsigned long)( value >> 32 ) ) ) return (int)index + 32;
+
+	_BitScanReverse( &index, (unsigned long)value );
+#endif
+	return (int)index;
+#else
+	return 63 - __builtin_clzll( value );
+#endif
+}
+
+#if PROBES_USE_TSC
+/*
+ * Measures the TSC frequency against the steady clock, once.
+ */
+static double compute_nano_seconds_per_tick()
+{
+	const auto start_time = steady_clock::now();
+	const uint64_t start_ticks = __rdtsc();
+
+	auto end_time = start_time;
+	while ( end_time - start_time < milliseconds( 10 ) )
+	{
+		end_time = steady_clock::now();
+	}
+	const uint64_t end_ticks = __rdtsc();
+
+	const double nano_seconds = (double)duration_cast<nanoseconds>( end_time - start_time ).count();
+	return nano_seconds / (double)( end_ticks - start_ticks );
+}
+
+static const double NANO_SECONDS_PER_TICK = compute_nano_seconds_per_tick();
+#endif
+
+Probe::Probe( const char* name )
+	: _name( name )
+{
+	//  Insert at the end to print probes in declaration order
+	Probe** link = &first_probe;
+	while ( *link )
+	{
+		link = &( *link )->_next;
+	}
+	*link = this;
+}
+
+void Probe::record( uint64_t nano_seconds )
+{
+	//  Each counter is only ever added to, relaxed ordering is enough
+	_count.fetch_add( 1, std::memory_order_relaxed );
+	_sum.fetch_add( nano_seconds, std::memory_order_relaxed );
+	_buckets[_value_to_bucket( nano_seconds )].fetch_add( 1, std::memory_order_relaxed );
+
+	uint64_t max = _max.load( std::memory_order_relaxed );
+	while ( nano_seconds > max && !_max.compare_exchange_weak( max, nano_seconds, std::memory_order_relaxed ) ) {}
+}
+
+void Probe::reset()
+{
+	_count.store( 0, std::memory_order_relaxed );
+	_sum.store( 0, std::memory_order_relaxed );
+	_max.store( 0, std::memory_order_relaxed );
+
+	for ( int i = 0; i < PROBE_BUCKET_COUNT; i++ )
+	{
+		_buckets[i].store( 0, std::memory_order_relaxed );
+	}
+}
+
+const char* Probe::get_name() const
+{
+	return _name;
+}
+
+uint64_t Probe::get_count() const
+{
+	return _count.load( std::memory_order_relaxed );
+}
+
+uint64_t Probe::get_max() const
+{
+	return _max.load( std::memory_order_relaxed );
+}
+
+double Probe::get_mean() const
+{
+	const uint64_t count = get_count();
+	if ( count == 0 ) return 0.0;
+	return (double)_sum.load( std::memory_order_relaxed ) / count;
+}
+
+uint64_t Probe::get_percentile( float percentile ) const
+{
+	//  Timings recorded meanwhile may be missed, the rank is clamped to what was seen
+	const uint64_t count = get_count();
+	const uint64_t max = get_max();
+	if ( count == 0 ) return 0;
+
+	//  Rank of the timing we are looking for, starting at 1
+	uint64_t rank = (uint64_t)( percentile / 100.0 * count + 0.5 );
+	if ( rank < 1 ) rank = 1;
+	if ( rank > count ) rank = count;
+
+	uint64_t cumulated_count = 0;
+	for ( int i = 0; i < PROBE_BUCKET_COUNT; i++ )
+	{
+		cumulated_count += _buckets[i].load( std::memory_order_relaxed );
+		if ( cumulated_count < rank ) continue;
+
+		//  The bucket bound can't be above the actual maximum
+		const uint64_t value = _bucket_to_upper_value( i );
+		return value < max ? value : max;
+	}
+
+	return max;
+}
+
+Probe* Probe::get_first()
+{
+	return first_probe;
+}
+
+Probe* Probe::get_next() const
+{
+	return _next;
+}
+
+Probe* Probe::find( const char* name )
+{
+	Probe* probe = first_probe;
+	while ( probe )
+	{
+		if ( strcmp( probe->_name, name ) == 0 ) return probe;
+
+		probe = probe->_next;
+	}
+	return nullptr;
+}
+
+void Probe::print_all()
+{
+	Probe* probe = first_probe;
+	while ( probe )
+	{
+		printf(
+			"Probe: %s: %llu calls, mean %.1f ns, p50 %llu ns, p99 %llu ns, max %llu ns\n",
+			probe->_name,
+			(unsigned long long)probe->get_count(),
+			probe->get_mean(),
+			(unsigned long long)probe->get_percentile( 50.0f ),
+			(unsigned long long)probe->get_percentile( 99.0f ),
+			(unsigned long long)probe->get_max()
+		);
+
+		probe = probe->_next;
+	}
+}
+
+void Probe::reset_all()
+{
+	Probe* probe = first_probe;
+	while ( probe )
+	{
+		probe->reset();
+		probe = probe->_next;
+	}
+}
+
+uint64_t Probe::now_ticks()
+{
+#if PROBES_USE_TSC
+	return __rdtsc();
+#else
+	return (uint64_t)duration_cast<nanoseconds>( steady_clock::now().time_since_epoch() ).count();
+#endif
+}
+
+uint64_t Probe::ticks_to_nano_seconds( uint64_t ticks )
+{
+#if PROBES_USE_TSC
+	return (uint64_t)( ticks * NANO_SECONDS_PER_TICK );
+#else
+	return ticks;
+#endif
+}
+
+int Probe::_value_to_bucket( uint64_t value )
+{
+	//  Small values get one bucket each
+	if ( value < PROBE_SUB_BUCKET_COUNT ) return (int)value;
+
+	//  Larger values are split linearly inside their power of two
+	const int exponent = highest_bit( value );
+	const int sub_bucket = (int)( value >> ( exponent - PROBE_SUB_BUCKET_BITS ) ) & ( PROBE_SUB_BUCKET_COUNT - 1 );
+	return ( exponent - PROBE_SUB_BUCKET_BITS + 1 ) * PROBE_SUB_BUCKET_COUNT + sub_bucket;
+}
+
+uint64_t Probe::_bucket_to_upper_value( int bucket )
+{
+	if ( bucket < PROBE_SUB_BUCKET_COUNT ) return (uint64_t)bucket;
+
+	const int exponent = bucket / PROBE_SUB_BUCKET_COUNT + PROBE_SUB_BUCKET_BITS - 1;
+	const uint64_t sub_bucket = bucket % PROBE_SUB_BUCKET_COUNT;
+	const int shift = exponent - PROBE_SUB_BUCKET_BITS;
+
+	const uint64_t lower_value = ( (uint64_t)PROBE_SUB_BUCKET_COUNT + sub_bucket ) << shift;
+	return lower_value + ( 1ull << shift ) - 1;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/*
+ * Compile-time switch for the latency probes, define it to 1 to enable them.
+ * They are disabled by default since timing each call costs several times a reservation.
+ */
+#ifndef ENABLE_PROBES
+#define ENABLE_PROBES 0
+#endif
+
+/*
+ * Define it to 1 to time probes with the CPU time-stamp counter instead of the steady clock.
+ * It is cheaper to read but assumes an invariant TSC, which is the case on recent x86 CPUs.
+ */
+#ifndef PROBES_USE_TSC
+#define PROBES_USE_TSC 0
+#endif
+
+/*
+ * Amount of linear sub-buckets per power of two in the latency histogram, as a power of two.
+ * With 3 bits, a recorded latency is at most 12.5% away from its bucket bounds.
+ */
+const int PROBE_SUB_BUCKET_BITS = 3;
+const int PROBE_SUB_BUCKET_COUNT = 1 << PROBE_SUB_BUCKET_BITS;
+const int PROBE_BUCKET_COUNT = ( 64 - PROBE_SUB_BUCKET_BITS + 1 ) * PROBE_SUB_BUCKET_COUNT;
+
+/*
+ * A named latency probe accumulating nanosecond timings inside a log-linear histogram,
+ * allowing to query percentiles in constant memory.
+ * Probes register themselves in a global list at construction, they are meant to be
+ * declared as static variables. Timings can be recorded from any thread.
+ */
+class Probe
+{
+public:
+	Probe( const char* name );
+
+	/*
+	 * Adds a timing, in nanoseconds, to the histogram.
+	 */
+	void record( uint64_t nano_seconds );
+	/*
+	 * Forgets all recorded timings.
+	 */
+	void reset();
+
+	const char* get_name() const;
+	uint64_t get_count() const;
+	uint64_t get_max() const;
+	double get_mean() const;
+	/*
+	 * Returns the upper bound of the bucket containing the given percentile, in nanoseconds.
+	 * The percentile ranges from 0.0f to 100.0f.
+	 */
+	uint64_t get_percentile( float percentile ) const;
+
+	/*
+	 * Returns the first registered probe, to iterate on all probes with 'get_next'.
+	 */
+	static Probe* get_first();
+	Probe* get_next() const;
+	/*
+	 * Returns the registered probe of the given name or nullptr if none.
+	 */
+	static Probe* find( const char* name );
+
+	/*
+	 * Prints the count, mean, p50, p99 and max of all registered probes to the standard output.
+	 */
+	static void print_all();
+	/*
+	 * Resets all registered probes.
+	 */
+	static void reset_all();
+
+	/*
+	 * Returns the current time in ticks of the probes clock.
+	 */
+	static uint64_t now_ticks();
+	/*
+	 * Converts a duration from ticks of the probes clock to nanoseconds.
+	 */
+	static uint64_t ticks_to_nano_seconds( uint64_t ticks );
+
+private:
+	static int _value_to_bucket( uint64_t value );
+	static uint64_t _bucket_to_upper_value( int bucket );
+
+private:
+	const char* _name = nullptr;
+	Probe* _next = nullptr;
+
+	std::atomic<uint64_t> _count { 0 };
+	std::atomic<uint64_t> _sum { 0 };
+	std::atomic<uint64_t> _max { 0 };
+	std::atomic<uint64_t> _buckets[PROBE_BUCKET_COUNT] {};
+};
+
+/*
+ * Times its own lifetime and records it into the given probe.
+ */
+class ScopedProbe
+{
+public:
+	ScopedProbe( Probe& probe )
+		: _probe( probe ), _start( Probe::now_ticks() ) {}
+	~ScopedProbe()
+	{
+		_probe.record( Probe::ticks_to_nano_seconds( Probe::now_ticks() - _start ) );
+	}
+
+	ScopedProbe( const ScopedProbe& ) = delete;
+	ScopedProbe& operator=( const ScopedProbe& ) = delete;
+
+private:
+	Probe& _probe;
+	uint64_t _start = 0;
+};
+
+#define PROBE_CONCAT_IMPL( a, b ) a##b
+#define PROBE_CONCAT( a, b ) PROBE_CONCAT_IMPL( a, b )
+
+/*
+ * Times the rest of the current scope into the given probe, compiled out when probes are disabled.
+ */
+#if ENABLE_PROBES
+#define PROBE_SCOPE( probe ) ScopedProbe PROBE_CONCAT( _scoped_probe_, __LINE__ )( probe )
+#else
+#define PROBE_SCOPE( probe ) ( (void)0 )
+#endif
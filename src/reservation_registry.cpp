@@ -0,0 +1,83 @@
+#include "reservation_registry.h"
+
+ReservationId ReservationRegistry::add( const Reservation& reservation )
+{
+	if ( _by_offset.count( reservation.offset ) > 0 ) return ReservationId {};
+
+	//  Reuse an unused slot before growing
+	uint32_t index = _unused_slot;
+	if ( index == UINT32_MAX )
+	{
+		index = (uint32_t)_slots.size();
+		_slots.emplace_back();
+	}
+	else
+	{
+		_unused_slot = _slots[index].next_unused;
+	}
+
+	Slot& slot = _slots[index];
+	slot.reservation = reservation;
+	slot.is_used = true;
+	slot.next_unused = UINT32_MAX;
+	slot.position = _by_offset.emplace( reservation.offset, index ).first;
+	return ReservationId { index, slot.generation };
+}
+
+bool ReservationRegistry::remove( ReservationId id )
+{
+	if ( get( id ) == nullptr ) return false;
+
+	Slot& slot = _slots[id.index];
+	_by_offset.erase( slot.position );
+
+	slot.reservation = Reservation {};
+	slot.generation++;
+	slot.is_used = false;
+	slot.next_unused = _unused_slot;
+	_unused_slot = id.index;
+	return true;
+}
+
+void ReservationRegistry::clear()
+{
+	//  Keep the slots so that the ids given so far stay invalid
+	_by_offset.clear();
+	_unused_slot = UINT32_MAX;
+	for ( uint32_t i = (uint32_t)_slots.size(); i-- > 0; )
+	{
+		Slot& slot = _slots[i];
+		if ( slot.is_used )
+		{
+			slot.reservation = Reservation {};
+			slot.generation++;
+			slot.is_used = false;
+		}
+
+		slot.next_unused = _unused_slot;
+		_unused_slot = i;
+	}
+}
+
+const Reservation* ReservationRegistry::get( ReservationId id ) const
+{
+	if ( id.index >= _slots.size() ) return nullptr;
+
+	const Slot& slot = _slots[id.index];
+	if ( !slot.is_used || slot.generation != id.generation ) return nullptr;
+
+	return &slot.reservation;
+}
+
+ReservationId ReservationRegistry::find( uint32_t offset ) const
+{
+	//  Last reservation starting at or before the offset
+	auto itr = _by_offset.upper_bound( offset );
+	if ( itr == _by_offset.begin() ) return ReservationId {};
+	--itr;
+
+	const Slot& slot = _slots[itr->second];
+	if ( (uint64_t)slot.reservation.offset + slot.reservation.size <= offset ) return ReservationId {};
+
+	return ReservationId { itr->second, slot.generation };
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+struct Reservation
+{
+	uint32_t size = 0;
+	uint32_t offset = 0;
+	void* data = nullptr;
+};
+
+/*
+ * Stable handle to a reservation of the registry. It stays valid until the reservation is removed,
+ * whatever happens to the other ones, and is never reused for another reservation.
+ */
+struct ReservationId
+{
+	uint32_t index = UINT32_MAX;
+	uint32_t generation = 0;
+
+	bool is_valid() const { return index != UINT32_MAX; }
+};
+
+/*
+ * Reservations stored in a slot map for constant time access and removal by id, and
+ * indexed by offset for logarithmic time lookup of the reservation covering a position.
+ */
+class ReservationRegistry
+{
+public:
+	/*
+	 * Registers the reservation and returns its id.
+	 * Returns an invalid id if a reservation already starts at the same offset.
+	 */
+	ReservationId add( const Reservation& reservation );
+	/*
+	 * Un-registers the reservation, returns false if the id is not valid anymore.
+	 */
+	bool remove( ReservationId id );
+	void clear();
+
+	/*
+	 * Returns the reservation of the given id or nullptr if it was removed.
+	 */
+	const Reservation* get( ReservationId id ) const;
+	/*
+	 * Returns the id of the reservation covering the given offset or an invalid id if none.
+	 */
+	ReservationId find( uint32_t offset ) const;
+
+	/*
+	 * Calls 'callback( ReservationId, const Reservation& )' for each reservation overlapping
+	 * the given range, in offset order.
+	 */
+	template <typename Callback>
+	void visit_range( uint32_t offset, uint32_t size, Callback callback ) const
+	{
+		const uint64_t end = (uint64_t)offset + size;
+
+		//  Start from the reservation covering the offset, if any
+		auto itr = _by_offset.upper_bound( offset );
+		if ( itr != _by_offset.begin() )
+		{
+			auto previous = itr;
+			--previous;
+
+			const Reservation& reservation = _slots[previous->second].reservation;
+			if ( (uint64_t)reservation.offset + reservation.size > offset )
+			{
+				itr = previous;
+			}
+		}
+
+		for ( ; itr != _by_offset.end() && itr->first < end; ++itr )
+		{
+			const Slot& slot = _slots[itr->second];
+			callback( ReservationId { itr->second, slot.generation }, slot.reservation );
+		}
+	}
+
+	int get_count() const { return (int)_by_offset.size(); }
+
+private:
+	struct Slot
+	{
+		Reservation reservation {};
+		/*
+		 * Incremented on removal so that older ids of this slot become invalid
+		 */
+		uint32_t generation = 0;
+		bool is_used = false;
+		/*
+		 * Next unused slot, for linked list purposes
+		 */
+		uint32_t next_unused = UINT32_MAX;
+		std::map<uint32_t, uint32_t>::iterator position {};
+	};
+
+private:
+	std::vector<Slot> _slots {};
+	uint32_t _unused_slot = UINT32_MAX;
+
+	/*
+	 * Slot index of each reservation, sorted by offset
+	 */
+	std::map<uint32_t, uint32_t> _by_offset {};
+};
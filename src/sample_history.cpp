@@ -0,0 +1,49 @@
+#include "sample_history.h"
+
+#include <algorithm>
+
+SampleHistory::SampleHistory( int capacity )
+	: _values( std::max( capacity, 1 ), 0.0f )
+{}
+
+void SampleHistory::push( float value )
+{
+	if ( _count < get_capacity() )
+	{
+		_values[( _start + _count ) % get_capacity()] = value;
+		_count++;
+		return;
+	}
+
+	//  Full: overwrite the oldest sample
+	_values[_start] = value;
+	_start = ( _start + 1 ) % get_capacity();
+}
+
+void SampleHistory::clear()
+{
+	_start = 0;
+	_count = 0;
+}
+
+float SampleHistory::get( int index ) const
+{
+	return _values[( _start + index ) % get_capacity()];
+}
+
+float SampleHistory::get_last() const
+{
+	if ( _count == 0 ) return 0.0f;
+
+	return get( _count - 1 );
+}
+
+float SampleHistory::get_max() const
+{
+	float max = 0.0f;
+	for ( int i = 0; i < _count; i++ )
+	{
+		max = std::max( max, get( i ) );
+	}
+	return max;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+
+/*
+ * Keeps the latest samples of a value in a ring buffer, overwriting the oldest ones.
+ */
+class SampleHistory
+{
+public:
+	SampleHistory( int capacity = 120 );
+
+	void push( float value );
+	void clear();
+
+	/*
+	 * Returns the sample at the given index, from 0 for the oldest to 'get_count() - 1' for the latest.
+	 */
+	float get( int index ) const;
+	float get_last() const;
+	float get_max() const;
+
+	int get_count() const { return _count; }
+	int get_capacity() const { return (int)_values.size(); }
+
+private:
+	std::vector<float> _values {};
+	int _start = 0;
+	int _count = 0;
+};
@@ -0,0 +1,320 @@
+#include "slab_allocator.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static uint32_t count_trailing_zeros( uint64_t value )
+{
+#ifdef _MSC_VER
+	unsigned long index = 0;
+#ifdef _M_X64
+	_BitScanForward64( &index, value );
+#else
+	//  No 64-bits scan on 32-bits targets, scan the low then the high half
+	if ( _BitScanForward( &index, (unsigned long)value ) ) return (uint32_t)index;
+
+	_BitScanForward( &index, (unsigned long)( value >> 32 ) );
+	index += 32;
+#endif
+	return (uint32_t)index;
+#else
+	return (uint32_t)__builtin_ctzll( value );
+#endif
+}
+
+SlabAllocator::SlabAllocator( Freelist& freelist, uint32_t max_slab_size )
+	: _freelist( freelist )
+{
+	//  Slots must at least fit twice in a page, otherwise slabs only waste space
+	const uint32_t max_size = SLAB_PAGE_SIZE / 2;
+	if ( max_slab_size > max_size )
+	{
+		max_slab_size = max_size;
+	}
+	_max_slab_size = ( max_slab_size + SLAB_GRANULARITY - 1 ) / SLAB_GRANULARITY * SLAB_GRANULARITY;
+
+	const int class_count = (int)( _max_slab_size / SLAB_GRANULARITY );
+	_class_partial.assign( class_count, -1 );
+	_class_slab_count.assign( class_count, 0 );
+
+	_update_page_count();
+}
+
+SlabAllocator::~SlabAllocator()
+{
+	for ( int i = 0; i < (int)_slabs.size(); i++ )
+	{
+		if ( _slabs[i].size_class == -1 ) continue;
+
+		_freelist.unreserve( _slabs[i].offset, SLAB_PAGE_SIZE );
+	}
+}
+
+FreelistError SlabAllocator::reserve( uint32_t size, uint32_t& offset )
+{
+	if ( size == 0 || size > _max_slab_size )
+	{
+		return _freelist.reserve( size, offset );
+	}
+
+	const int size_class = (int)( ( size + SLAB_GRANULARITY - 1 ) / SLAB_GRANULARITY ) - 1;
+
+	int index = _class_partial[size_class];
+	if ( index == -1 )
+	{
+		index = _new_slab( size_class );
+
+		//  No page available, the freelist may still have a small enough hole
+		if ( index == -1 ) return _freelist.reserve( size, offset );
+	}
+
+	Slab& slab = _slabs[index];
+	for ( uint32_t word = 0; word < SLAB_BITMAP_WORDS; word++ )
+	{
+		const uint64_t bits = slab.free_bits[word];
+		if ( bits == 0 ) continue;
+
+		const uint32_t bit = count_trailing_zeros( bits );
+		slab.free_bits[word] = bits & ( bits - 1 );
+		slab.used_count++;
+
+		//  Full slabs are not looked at until one of their slots is un-reserved
+		if ( slab.used_count == slab.slot_count )
+		{
+			_unlink_partial( index );
+		}
+
+		offset = slab.offset + ( word * 64 + bit ) * slab.slot_size;
+		return FreelistError::None;
+	}
+
+	//  Slabs in the partial list always have a free slot
+	return FreelistError::OutOfSpace;
+}
+
+FreelistError SlabAllocator::unreserve( uint32_t offset, uint32_t size )
+{
+	const int index = size <= _max_slab_size ? _find_slab( offset ) : -1;
+	if ( index == -1 ) return _freelist.unreserve( offset, size );
+
+	//  Zero out memory, same as the freelist does
+	memset( pointer_to_memory( offset ), 0, size );
+
+	Slab& slab = _slabs[index];
+	const uint32_t slot = ( offset - slab.offset ) / slab.slot_size;
+	slab.free_bits[slot / 64] |= 1ull << ( slot % 64 );
+
+	if ( slab.used_count == slab.slot_count )
+	{
+		_link_partial( index );
+	}
+	slab.used_count--;
+
+	//  Give empty slabs back, keeping the last one of its class for further reservations
+	if ( slab.used_count == 0 && _class_slab_count[slab.size_class] > 1 )
+	{
+		_release_slab( index );
+	}
+
+	return FreelistError::None;
+}
+
+void SlabAllocator::clear()
+{
+	_freelist.clear();
+
+	const uint32_t page_count = (uint32_t)_slabs.size();
+	for ( uint32_t i = 0; i < page_count; i++ )
+	{
+		_slabs[i] = Slab {};
+		_slabs[i].next = i + 1 < page_count ? (int)i + 1 : -1;
+	}
+	_free_slab = page_count > 0 ? 0 : -1;
+	_slab_count = 0;
+
+	std::fill( _class_partial.begin(), _class_partial.end(), -1 );
+	std::fill( _class_slab_count.begin(), _class_slab_count.end(), 0 );
+	std::fill( _page_to_slab.begin(), _page_to_slab.end(), -1 );
+}
+
+void SlabAllocator::trim()
+{
+	for ( int i = 0; i < (int)_slabs.size(); i++ )
+	{
+		const Slab& slab = _slabs[i];
+		if ( slab.size_class == -1 || slab.used_count > 0 ) continue;
+
+		_release_slab( i );
+	}
+}
+
+void* SlabAllocator::pointer_to_memory( uint32_t offset ) const
+{
+	return _freelist.pointer_to_memory( offset );
+}
+
+uint32_t SlabAllocator::get_max_slab_size() const
+{
+	return _max_slab_size;
+}
+
+int SlabAllocator::get_slab_count() const
+{
+	return _slab_count;
+}
+
+uint32_t SlabAllocator::get_slab_free_size() const
+{
+	uint32_t bytes = 0;
+
+	for ( int i = 0; i < (int)_slabs.size(); i++ )
+	{
+		const Slab& slab = _slabs[i];
+		if ( slab.size_class == -1 ) continue;
+
+		bytes += SLAB_PAGE_SIZE - slab.used_count * slab.slot_size;
+	}
+
+	return bytes;
+}
+
+int SlabAllocator::_new_slab( int size_class )
+{
+	//  The freelist may have grown since the last slab
+	_update_page_count();
+	if ( _free_slab == -1 ) return -1;
+
+	//  Pages live as long as their size class is used, keep them together at the bottom of the memory
+	//  instead of scattered between the larger reservations
+	uint32_t offset = 0;
+	if ( _freelist.reserve( SLAB_PAGE_SIZE, offset, FreelistLifetime::LongLived ) != FreelistError::None ) return -1;
+
+	//  Or grown by the out-of-memory handler to fit this page
+	_update_page_count();
+
+	const int index = _free_slab;
+	Slab& slab = _slabs[index];
+	_free_slab = slab.next;
+
+	slab.offset = offset;
+	slab.slot_size = ( size_class + 1 ) * SLAB_GRANULARITY;
+	slab.slot_count = (uint16_t)( SLAB_PAGE_SIZE / slab.slot_size );
+	slab.used_count = 0;
+	slab.size_class = size_class;
+	slab.previous = -1;
+	slab.next = -1;
+
+	//  Mark all slots as free
+	memset( slab.free_bits, 0, sizeof( slab.free_bits ) );
+	for ( uint32_t slot = 0; slot < slab.slot_count; slot += 64 )
+	{
+		const uint32_t count = slab.slot_count - slot;
+		slab.free_bits[slot / 64] = count >= 64 ? ~0ull : ( 1ull << count ) - 1;
+	}
+
+	_page_to_slab[offset / SLAB_PAGE_SIZE] = index;
+	_class_slab_count[size_class]++;
+	_slab_count++;
+	_link_partial( index );
+
+	return index;
+}
+
+void SlabAllocator::_release_slab( int index )
+{
+	Slab& slab = _slabs[index];
+	if ( _freelist.unreserve( slab.offset, SLAB_PAGE_SIZE ) != FreelistError::None ) return;
+
+	_unlink_partial( index );
+
+	_page_to_slab[slab.offset / SLAB_PAGE_SIZE] = -1;
+	_class_slab_count[slab.size_class]--;
+	_slab_count--;
+
+	//  Invalidate slab and chain it as unused
+	slab = Slab {};
+	slab.next = _free_slab;
+	_free_slab = index;
+}
+
+int SlabAllocator::_find_slab( uint32_t offset ) const
+{
+	//  A slab containing the offset either starts in its window or in the previous one
+	const uint32_t page = offset / SLAB_PAGE_SIZE;
+	for ( uint32_t i = 0; i < 2 && i <= page; i++ )
+	{
+		//  Windows past the table were added by a grow after the last slab, they hold none
+		if ( page - i >= _page_to_slab.size() ) continue;
+
+		const int index = _page_to_slab[page - i];
+		if ( index == -1 ) continue;
+
+		const Slab& slab = _slabs[index];
+		if ( slab.offset <= offset && offset < slab.offset + SLAB_PAGE_SIZE )
+		{
+			return index;
+		}
+	}
+
+	return -1;
+}
+
+void SlabAllocator::_link_partial( int index )
+{
+	Slab& slab = _slabs[index];
+	int& head = _class_partial[slab.size_class];
+
+	slab.previous = -1;
+	slab.next = head;
+	if ( head != -1 )
+	{
+		_slabs[head].previous = index;
+	}
+	head = index;
+}
+
+void SlabAllocator::_unlink_partial( int index )
+{
+	Slab& slab = _slabs[index];
+
+	//  Full slabs are not linked
+	if ( slab.previous == -1 && _class_partial[slab.size_class] != index ) return;
+
+	if ( slab.previous != -1 )
+	{
+		_slabs[slab.previous].next = slab.next;
+	}
+	else
+	{
+		_class_partial[slab.size_class] = slab.next;
+	}
+
+	if ( slab.next != -1 )
+	{
+		_slabs[slab.next].previous = slab.previous;
+	}
+
+	slab.previous = -1;
+	slab.next = -1;
+}
+
+void SlabAllocator::_update_page_count()
+{
+	const uint32_t page_count = _freelist.get_data_size() / SLAB_PAGE_SIZE;
+	const uint32_t old_page_count = (uint32_t)_slabs.size();
+	if ( page_count <= old_page_count ) return;
+
+	//  One slab record per page, the new ones are chained in front of the unused ones
+	_slabs.resize( page_count );
+	for ( uint32_t i = old_page_count; i < page_count; i++ )
+	{
+		_slabs[i].next = i + 1 < page_count ? (int)i + 1 : _free_slab;
+	}
+	_free_slab = (int)old_page_count;
+
+	_page_to_slab.resize( page_count + 1, -1 );
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "freelist.h"
+
+/*
+ * Size of a slab page, in bytes. Each slab reserves exactly one page from the freelist.
+ */
+const uint32_t SLAB_PAGE_SIZE = 4096;
+/*
+ * Size classes are multiples of this granularity, in bytes.
+ */
+const uint32_t SLAB_GRANULARITY = 16;
+/*
+ * Maximum amount of slots a slab can hold, reached with the smallest size class.
+ */
+const uint32_t SLAB_MAX_SLOTS = SLAB_PAGE_SIZE / SLAB_GRANULARITY;
+/*
+ * Amount of 64-bits words needed to hold the free bitmap of a slab.
+ */
+const uint32_t SLAB_BITMAP_WORDS = SLAB_MAX_SLOTS / 64;
+
+/*
+ * A page-sized run reserved from the freelist and split into equally sized slots.
+ */
+struct Slab
+{
+	/*
+	 * Position of the page inside the freelist memory
+	 */
+	uint32_t offset = 0;
+	/*
+	 * Size of each slot of the page, in bytes
+	 */
+	uint32_t slot_size = 0;
+	uint16_t slot_count = 0;
+	uint16_t used_count = 0;
+	int size_class = -1;
+
+	/*
+	 * For linked list purposes, the previous and next slabs of the same size class having
+	 * at least one free slot. Also used to chain unused slab records together.
+	 */
+	int previous = -1;
+	int next = -1;
+
+	/*
+	 * Bitmap of the slots, a set bit meaning the slot is free.
+	 */
+	uint64_t free_bits[SLAB_BITMAP_WORDS] {};
+};
+
+/*
+ * A hybrid allocator sitting in front of a freelist: small reservations are served from
+ * per-size-class slabs in constant time, while larger ones go directly to the freelist.
+ * Slabs are reserved from the freelist on demand and given back once empty, only keeping
+ * the last one of each size class to avoid reserving and un-reserving a page on every call.
+ */
+class SlabAllocator
+{
+public:
+	/*
+	 * Prepares the slab records for the given freelist. Reservations up to 'max_slab_size'
+	 * bytes are served from slabs, this size is rounded up to the slab granularity.
+	 */
+	SlabAllocator( Freelist& freelist, uint32_t max_slab_size = 256 );
+	/*
+	 * Gives all slabs back to the freelist.
+	 */
+	~SlabAllocator();
+
+	/*
+	 * Finds and reserves a memory block of the given size.
+	 * Returns FreelistError::None if the reservation was successful, or the failure reason.
+	 * If successful, it also sets the 'offset' variable to the reserved position.
+	 */
+	FreelistError reserve( uint32_t size, uint32_t& offset );
+	/*
+	 * Un-reserves the memory block at given offset and size.
+	 */
+	FreelistError unreserve( uint32_t offset, uint32_t size );
+	/*
+	 * Clears the underlying freelist and forgets about all slabs.
+	 */
+	void clear();
+	/*
+	 * Gives all empty slabs back to the freelist, including the ones kept for reuse.
+	 */
+	void trim();
+
+	/*
+	 * Returns a pointer to the memory given the offset.
+	 */
+	void* pointer_to_memory( uint32_t offset ) const;
+
+	/*
+	 * Returns the maximum size served by slabs, in bytes.
+	 */
+	uint32_t get_max_slab_size() const;
+	/*
+	 * Returns the amount of slabs currently reserved from the freelist.
+	 */
+	int get_slab_count() const;
+	/*
+	 * Returns the amount of bytes reserved by slabs which are not given to any slot.
+	 */
+	uint32_t get_slab_free_size() const;
+
+private:
+	/*
+	 * Reserves a new page from the freelist for the given size class.
+	 * Returns the slab index or -1 if the freelist is out of space.
+	 */
+	int _new_slab( int size_class );
+	/*
+	 * Un-links the slab and gives its page back to the freelist.
+	 * If the freelist can't take it back, the slab is kept empty for further reservations.
+	 */
+	void _release_slab( int index );
+	/*
+	 * Returns the index of the slab containing the given offset or -1 if none.
+	 */
+	int _find_slab( uint32_t offset ) const;
+	/*
+	 * Adds slab records and page windows for the freelist memory grown since the last call.
+	 */
+	void _update_page_count();
+
+	void _link_partial( int index );
+	void _unlink_partial( int index );
+
+private:
+	Freelist& _freelist;
+	uint32_t _max_slab_size = 0;
+
+	std::vector<Slab> _slabs {};
+	int _free_slab = -1;
+	int _slab_count = 0;
+
+	/*
+	 * Per size class, the first slab having a free slot and the amount of slabs.
+	 */
+	std::vector<int> _class_partial {};
+	std::vector<int> _class_slab_count {};
+
+	/*
+	 * Index of the slab starting in each page-sized window of the freelist memory.
+	 * Slabs never overlap, so at most one of them can start in a given window.
+	 */
+	std::vector<int> _page_to_slab {};
+};
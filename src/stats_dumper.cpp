@@ -0,0 +1,149 @@
+#include "stats_dumper.h"
+
+namespace
+{
+	/*
+	 * Column prefixes of the lifetime statistics, indexed by FreelistLifetime
+	 */
+	const char* LIFETIME_NAMES[FREELIST_LIFETIME_COUNT] { "normal", "transient", "long_lived" };
+}
+
+StatsDumper::StatsDumper( const char* path, StatsDumpFormat format, float interval )
+	: _format( format ), _interval( interval )
+{
+#ifdef _MSC_VER
+	if ( fopen_s( &_file, path, "w" ) != 0 )
+	{
+		_file = nullptr;
+	}
+#else
+	_file = fopen( path, "w" );
+#endif
+	if ( _file == nullptr )
+	{
+		printf( "StatsDumper failed to open '%s'\n", path );
+		return;
+	}
+
+	if ( _format == StatsDumpFormat::CSV )
+	{
+		fprintf( _file, "time,used_size,peak_used_size,free_size,largest_free_size,free_block_count,fragmentation,deferred_size,deferred_count,reserve_count,unreserve_count,failure_count" );
+		for ( int i = 0; i < FREELIST_LIFETIME_COUNT; i++ )
+		{
+			fprintf( _file, ",%s_reserve_count,%s_reserved_size,%s_failure_count", LIFETIME_NAMES[i], LIFETIME_NAMES[i], LIFETIME_NAMES[i] );
+		}
+		for ( int i = 0; i < FREELIST_SIZE_HISTOGRAM_BUCKETS; i++ )
+		{
+			fprintf( _file, ",size_%u", 1u << i );
+		}
+		fprintf( _file, "\n" );
+	}
+}
+
+StatsDumper::~StatsDumper()
+{
+	if ( _file == nullptr ) return;
+
+	fclose( _file );
+	_file = nullptr;
+}
+
+void StatsDumper::update( const Freelist& freelist, float dt )
+{
+	_time += dt;
+	_elapsed_time += dt;
+	if ( _elapsed_time < _interval ) return;
+
+	_elapsed_time = 0.0f;
+	dump( freelist.get_stats() );
+}
+
+void StatsDumper::dump( const FreelistStats& stats )
+{
+	if ( _file == nullptr ) return;
+
+	if ( _format == StatsDumpFormat::CSV )
+	{
+		fprintf(
+			_file,
+			"%.3f,%u,%u,%u,%u,%d,%.4f,%u,%d,%llu,%llu,%llu",
+			_time,
+			stats.used_size,
+			stats.peak_used_size,
+			stats.free_size,
+			stats.largest_free_size,
+			stats.free_block_count,
+			stats.get_fragmentation(),
+			stats.deferred_size,
+			stats.deferred_count,
+			(unsigned long long)stats.reserve_count,
+			(unsigned long long)stats.unreserve_count,
+			(unsigned long long)stats.failure_count
+		);
+		for ( int i = 0; i < FREELIST_LIFETIME_COUNT; i++ )
+		{
+			const FreelistLifetimeStats& lifetime_stats = stats.lifetime_stats[i];
+			fprintf(
+				_file,
+				",%llu,%llu,%llu",
+				(unsigned long long)lifetime_stats.reserve_count,
+				(unsigned long long)lifetime_stats.reserved_size,
+				(unsigned long long)lifetime_stats.failure_count
+			);
+		}
+		for ( int i = 0; i < FREELIST_SIZE_HISTOGRAM_BUCKETS; i++ )
+		{
+			fprintf( _file, ",%llu", (unsigned long long)stats.size_histogram[i] );
+		}
+		fprintf( _file, "\n" );
+	}
+	else
+	{
+		fprintf(
+			_file,
+			"{\"time\":%.3f,\"used_size\":%u,\"peak_used_size\":%u,\"free_size\":%u,\"largest_free_size\":%u,"
+			"\"free_block_count\":%d,\"fragmentation\":%.4f,\"deferred_size\":%u,\"deferred_count\":%d,"
+			"\"reserve_count\":%llu,\"unreserve_count\":%llu,"
+			"\"failure_count\":%llu,\"lifetime_stats\":{",
+			_time,
+			stats.used_size,
+			stats.peak_used_size,
+			stats.free_size,
+			stats.largest_free_size,
+			stats.free_block_count,
+			stats.get_fragmentation(),
+			stats.deferred_size,
+			stats.deferred_count,
+			(unsigned long long)stats.reserve_count,
+			(unsigned long long)stats.unreserve_count,
+			(unsigned long long)stats.failure_count
+		);
+		for ( int i = 0; i < FREELIST_LIFETIME_COUNT; i++ )
+		{
+			const FreelistLifetimeStats& lifetime_stats = stats.lifetime_stats[i];
+			fprintf(
+				_file,
+				"%s\"%s\":{\"reserve_count\":%llu,\"reserved_size\":%llu,\"failure_count\":%llu}",
+				i == 0 ? "" : ",",
+				LIFETIME_NAMES[i],
+				(unsigned long long)lifetime_stats.reserve_count,
+				(unsigned long long)lifetime_stats.reserved_size,
+				(unsigned long long)lifetime_stats.failure_count
+			);
+		}
+		fprintf( _file, "},\"size_histogram\":[" );
+		for ( int i = 0; i < FREELIST_SIZE_HISTOGRAM_BUCKETS; i++ )
+		{
+			fprintf( _file, i == 0 ? "%llu" : ",%llu", (unsigned long long)stats.size_histogram[i] );
+		}
+		fprintf( _file, "]}\n" );
+	}
+
+	//  Monitoring tails the file, don't keep snapshots in the buffer
+	fflush( _file );
+}
+
+bool StatsDumper::is_valid() const
+{
+	return _file != nullptr;
+}
\ No newline at end of file
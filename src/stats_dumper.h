@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdio.h>
+
+#include "freelist.h"
+
+enum class StatsDumpFormat
+{
+	/*
+	 * One header line followed by one line of comma-separated values per dump
+	 */
+	CSV,
+	/*
+	 * One JSON object per line and per dump
+	 */
+	JSON,
+};
+
+/*
+ * Periodically appends snapshots of the freelist statistics to a file, so they can be
+ * watched by external monitoring.
+ */
+class StatsDumper
+{
+public:
+	/*
+	 * Opens the file at the given path, overwriting it. Snapshots are written every 'interval' seconds.
+	 */
+	StatsDumper( const char* path, StatsDumpFormat format, float interval = 1.0f );
+	/*
+	 * Closes the file.
+	 */
+	~StatsDumper();
+
+	/*
+	 * Advances the timer and dumps a snapshot of the freelist statistics once the interval is elapsed.
+	 */
+	void update( const Freelist& freelist, float dt );
+	/*
+	 * Directly writes the given snapshot to the file.
+	 */
+	void dump( const FreelistStats& stats );
+
+	/*
+	 * Returns whenever the file is opened.
+	 */
+	bool is_valid() const;
+
+private:
+	FILE* _file = nullptr;
+	StatsDumpFormat _format = StatsDumpFormat::CSV;
+
+	float _interval = 1.0f;
+	float _elapsed_time = 0.0f;
+	float _time = 0.0f;
+};
\ No newline at end of file
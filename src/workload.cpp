@@ -0,0 +1,71 @@
+#include "workload.h"
+
+#include <algorithm>
+
+Workload::Workload( uint32_t seed )
+	: _random( seed )
+{}
+
+void Workload::set_settings( const WorkloadSettings& settings )
+{
+	_settings = settings;
+}
+
+WorkloadOperation Workload::next()
+{
+	_operation++;
+
+	WorkloadOperation operation {};
+
+	std::uniform_real_distribution<float> ratio_distribution( 0.0f, 1.0f );
+	const bool should_reserve = _live_reservations.empty()
+		|| ratio_distribution( _random ) < _settings.reserve_ratio;
+	if ( should_reserve )
+	{
+		operation.is_reserve = true;
+		operation.size = _next_size();
+		return operation;
+	}
+
+	operation.is_reserve = false;
+	operation.id = _live_reservations.top().id;
+	_live_reservations.pop();
+	return operation;
+}
+
+void Workload::on_reserved( ReservationId id )
+{
+	std::exponential_distribution<float> lifetime_distribution( 1.0f / std::max( _settings.mean_lifetime, 1.0f ) );
+
+	LiveReservation reservation {};
+	reservation.end_operation = _operation + (uint64_t)lifetime_distribution( _random );
+	reservation.id = id;
+	_live_reservations.push( reservation );
+}
+
+void Workload::clear()
+{
+	_live_reservations = decltype( _live_reservations ) {};
+}
+
+uint32_t Workload::_next_size()
+{
+	const uint32_t min_size = std::min( _settings.min_size, _settings.max_size );
+	const uint32_t max_size = std::max( _settings.min_size, _settings.max_size );
+
+	switch ( _settings.size_distribution )
+	{
+		case WorkloadSizeDistribution::Exponential:
+		{
+			//  An eighth of the range as mean, clamped for the rare outliers
+			std::exponential_distribution<float> size_distribution( 8.0f / std::max( max_size - min_size, 1u ) );
+			return std::min( min_size + (uint32_t)size_distribution( _random ), max_size );
+		}
+		case WorkloadSizeDistribution::Uniform:
+		default:
+		{
+			std::uniform_int_distribution<uint32_t> size_distribution( min_size, max_size );
+			return size_distribution( _random );
+		}
+	}
+}
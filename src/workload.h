@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <random>
+#include <vector>
+
+#include "reservation_registry.h"
+
+enum class WorkloadSizeDistribution
+{
+	/*
+	 * Every size between the minimum and the maximum is equally likely
+	 */
+	Uniform,
+	/*
+	 * Mostly small sizes with a long tail of larger ones
+	 */
+	Exponential,
+};
+
+struct WorkloadSettings
+{
+	const char* name = "Uniform";
+
+	/*
+	 * Range of the reservation sizes, in bytes
+	 */
+	uint32_t min_size = 16;
+	uint32_t max_size = 256;
+	WorkloadSizeDistribution size_distribution = WorkloadSizeDistribution::Uniform;
+
+	/*
+	 * Probability for an operation to be a reservation, the other ones free the live reservation
+	 * which is the closest to the end of its lifetime
+	 */
+	float reserve_ratio = 0.5f;
+	/*
+	 * Mean lifetime of the reservations, in operations, exponentially distributed
+	 */
+	float mean_lifetime = 2000.0f;
+
+	int operations_per_frame = 2000;
+};
+
+struct WorkloadOperation
+{
+	bool is_reserve = true;
+	/*
+	 * Size to reserve, for reservations
+	 */
+	uint32_t size = 0;
+	/*
+	 * Reservation to free, for un-reservations
+	 */
+	ReservationId id {};
+};
+
+/*
+ * Synthetic workload generator: decides the next operation to run and remembers the live
+ * reservations along with the end of their lifetime.
+ */
+class Workload
+{
+public:
+	Workload( uint32_t seed = 1337 );
+
+	void set_settings( const WorkloadSettings& settings );
+	WorkloadSettings& get_settings() { return _settings; }
+	const WorkloadSettings& get_settings() const { return _settings; }
+
+	/*
+	 * Returns the next operation. Reservations must be reported back with 'on_reserved'
+	 * once successful, so they can be freed by a later operation.
+	 */
+	WorkloadOperation next();
+	void on_reserved( ReservationId id );
+	/*
+	 * Forgets about all live reservations, without freeing them.
+	 */
+	void clear();
+
+	int get_live_count() const { return (int)_live_reservations.size(); }
+
+private:
+	uint32_t _next_size();
+
+private:
+	struct LiveReservation
+	{
+		/*
+		 * Operation at which the reservation should be freed
+		 */
+		uint64_t end_operation = 0;
+		ReservationId id {};
+
+		bool operator>( const LiveReservation& other ) const { return end_operation > other.end_operation; }
+	};
+
+private:
+	WorkloadSettings _settings {};
+	std::mt19937 _random;
+	uint64_t _operation = 0;
+
+	/*
+	 * Live reservations, the closest to the end of its lifetime first
+	 */
+	std::priority_queue<LiveReservation, std::vector<LiveReservation>, std::greater<LiveReservation>> _live_reservations {};
+};